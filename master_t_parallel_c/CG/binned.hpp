@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace npb::cg {
+
+// Rows grouped by length class. NPB rows range from a few to a few hundred
+// nonzeros, so every row is padded up to the next multiple of class_step
+// and each class width gets its own instantiation of spmv_rows, whose row
+// loop is unrolled at compile time into straight-line code with no trip
+// count to test. Rows longer than max_width keep a generic CSR loop. Every
+// row is summed in CSR order and padding adds zeros, so results are
+// bit-identical to the CSR kernel.
+template <std::signed_integral Index>
+class BinnedMatrix {
+public:
+    static constexpr int64_t class_step = 8;
+    static constexpr int64_t max_width = 512;
+    static constexpr int64_t num_classes = max_width / class_step;
+
+    void build(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a
+    );
+
+    // y = A x. Orphaned worksharing: call from inside a parallel region.
+    // Rows are visited class by class, so it ends with a barrier before y
+    // can be read.
+    void multiply(const double* x, double* y) const noexcept;
+
+    // Stored slots, padding included
+    [[nodiscard]] int64_t slots() const noexcept { return static_cast<int64_t>(val_.size()); }
+
+    // Stored slots relative to the nonzeros (0 means no padding)
+    [[nodiscard]] double padding_ratio() const noexcept {
+        return nnz_ > 0 ? static_cast<double>(val_.size()) / nnz_ - 1.0 : 0.0;
+    }
+
+    // Length classes holding at least one row
+    [[nodiscard]] int64_t used_classes() const noexcept {
+        return std::count_if(classes_.begin(), classes_.end(), [](const RowClass& c) { return c.rows > 0; });
+    }
+
+    // Rows longer than max_width, left to the generic loop
+    [[nodiscard]] int64_t generic_rows() const noexcept { return static_cast<int64_t>(generic_ptr_.size()) - 1; }
+
+private:
+    struct RowClass {
+        int64_t first;     // first entry of rows_ in this class
+        int64_t rows;
+        int64_t offset;    // first slot in col_ and val_
+    };
+
+    using Kernel = void (BinnedMatrix::*)(const RowClass&, const double*, double*) const noexcept;
+
+    // Rows of class width Width, Width slots each
+    template <int64_t Width>
+    void spmv_rows(const RowClass& c, const double* x, double* y) const noexcept {
+        #pragma omp for nowait schedule(static)
+        for (int64_t i = 0; i < c.rows; i++) {
+            const int64_t slot = c.offset + i * Width;
+            y[rows_[c.first + i]] = row_sum(col_.data() + slot, val_.data() + slot, x,
+                                            std::make_integer_sequence<int64_t, Width>{});
+        }
+    }
+
+    template <int64_t... K>
+    static double row_sum(
+        const Index* col,
+        const double* val,
+        const double* x,
+        std::integer_sequence<int64_t, K...>
+    ) noexcept {
+        double sum = 0.0;
+        ((sum += val[K] * x[col[K]]), ...);
+        return sum;
+    }
+
+    template <size_t... I>
+    static constexpr std::array<Kernel, sizeof...(I)> make_kernels(std::index_sequence<I...>) {
+        return {&BinnedMatrix::spmv_rows<static_cast<int64_t>(I + 1) * class_step>...};
+    }
+
+    static constexpr std::array<Kernel, num_classes> kernels_ =
+        make_kernels(std::make_index_sequence<num_classes>{});
+
+    int64_t nnz_{0};
+
+    std::array<RowClass, num_classes> classes_{};   // class k has width (k + 1) * class_step
+    std::vector<Index> rows_;          // original row of each class entry, then the generic rows
+    std::vector<int64_t> generic_ptr_; // generic row extents in col_ and val_
+    std::vector<Index> col_;           // column indices, row by row
+    std::vector<double> val_;          // values, row by row
+};
+
+template <std::signed_integral Index>
+void BinnedMatrix<Index>::build(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+) {
+    const int64_t nrows = static_cast<int64_t>(rowstr.size()) - 1;
+    nnz_ = rowstr[nrows];
+
+    auto row_length = [&](const int64_t row) { return static_cast<int64_t>(rowstr[row + 1] - rowstr[row]); };
+    // Class index, or num_classes for the generic rows
+    auto row_class = [&](const int64_t row) {
+        const int64_t length = row_length(row);
+        return length > max_width ? num_classes : std::max<int64_t>(length - 1, 0) / class_step;
+    };
+
+    // Counting sort by class keeps the rows of a class in their original
+    // order, so the gathers and output stores stay as local as in CSR
+    std::array<int64_t, num_classes + 1> counts{};
+    for (int64_t row = 0; row < nrows; row++) {
+        counts[row_class(row)]++;
+    }
+
+    int64_t first = 0;
+    int64_t offset = 0;
+    for (int64_t k = 0; k < num_classes; k++) {
+        classes_[k] = {first, counts[k], offset};
+        first += counts[k];
+        offset += counts[k] * (k + 1) * class_step;
+    }
+
+    std::array<int64_t, num_classes + 1> next{};
+    for (int64_t k = 0; k < num_classes; k++) {
+        next[k] = classes_[k].first;
+    }
+    next[num_classes] = first;
+
+    rows_.resize(nrows);
+    for (int64_t row = 0; row < nrows; row++) {
+        rows_[next[row_class(row)]++] = static_cast<Index>(row);
+    }
+
+    generic_ptr_.assign(counts[num_classes] + 1, offset);
+    for (int64_t i = 0; i < counts[num_classes]; i++) {
+        generic_ptr_[i + 1] = generic_ptr_[i] + row_length(rows_[first + i]);
+    }
+
+    col_.resize(generic_ptr_.back());
+    val_.resize(generic_ptr_.back());
+
+    // Padding repeats the row's last column with a zero value: the sum is
+    // unchanged and the gather hits a line that is already loaded
+    #pragma omp parallel for schedule(static)
+    for (int64_t k = 0; k < num_classes; k++) {
+        const int64_t width = (k + 1) * class_step;
+        const RowClass& c = classes_[k];
+        for (int64_t i = 0; i < c.rows; i++) {
+            const int64_t row = rows_[c.first + i];
+            const int64_t length = row_length(row);
+            const int64_t slot = c.offset + i * width;
+            const Index pad = length > 0 ? colidx[rowstr[row] + length - 1] : Index{0};
+
+            std::copy_n(colidx.begin() + rowstr[row], length, col_.begin() + slot);
+            std::copy_n(a.begin() + rowstr[row], length, val_.begin() + slot);
+            std::fill(col_.begin() + slot + length, col_.begin() + slot + width, pad);
+            std::fill(val_.begin() + slot + length, val_.begin() + slot + width, 0.0);
+        }
+    }
+
+    for (int64_t i = 0; i < counts[num_classes]; i++) {
+        const int64_t row = rows_[first + i];
+        std::copy_n(colidx.begin() + rowstr[row], row_length(row), col_.begin() + generic_ptr_[i]);
+        std::copy_n(a.begin() + rowstr[row], row_length(row), val_.begin() + generic_ptr_[i]);
+    }
+}
+
+template <std::signed_integral Index>
+void BinnedMatrix<Index>::multiply(const double* x, double* y) const noexcept {
+    // Each class is split evenly over the threads, and rows of a class
+    // cost the same, so the nowait loops stay balanced
+    for (int64_t k = 0; k < num_classes; k++) {
+        if (classes_[k].rows > 0) {
+            (this->*kernels_[k])(classes_[k], x, y);
+        }
+    }
+
+    const int64_t first = static_cast<int64_t>(rows_.size()) - generic_rows();
+
+    #pragma omp for schedule(static)
+    for (int64_t i = 0; i < generic_rows(); i++) {
+        double sum = 0.0;
+        for (int64_t s = generic_ptr_[i]; s < generic_ptr_[i + 1]; s++) {
+            sum += val_[s] * x[col_[s]];
+        }
+        y[rows_[first + i]] = sum;
+    }
+}
+
+} // namespace npb::cg
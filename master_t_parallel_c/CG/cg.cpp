@@ -3,10 +3,14 @@
 
 #include <cmath>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <algorithm>
 #include <stdexcept>
 #include <ranges>
 #include <execution>
+#include <chrono>
+#include <bit>
 
 namespace npb::cg {
 
@@ -57,105 +61,1559 @@ double randlc(double *x, double a) noexcept {
     return r46 * (*x);
 }
 
+// Advance an LCG seed by n steps in O(log n) calls (seed * a^n mod 2^46),
+// mirroring find_my_seed in IS. The result is bit-identical to n sequential
+// randlc calls since randlc is exact integer arithmetic.
+static double jump_ahead(const double seed, const double a, int64_t n) noexcept {
+    double t1 = seed;
+    double t2 = a;
+    
+    while (n > 0) {
+        if (n & 1) {
+            (void)randlc(&t1, t2);
+        }
+        (void)randlc(&t2, t2);
+        n >>= 1;
+    }
+    
+    return t1;
+}
+
+// bfloat16 is the upper half of a float, rounded to nearest even on the
+// dropped bits
+static uint16_t to_bf16(const float value) noexcept {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    return static_cast<uint16_t>((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+static double from_bf16(const uint16_t value) noexcept {
+    return std::bit_cast<float>(static_cast<uint32_t>(value) << 16);
+}
+
 constexpr int64_t convert_real_to_int(const double x, const int64_t power2) noexcept {
     return static_cast<int64_t>(power2 * x);
 }
 
-SparseMatrix::SparseMatrix(const Problem& params) 
+template <std::signed_integral Index>
+SparseMatrix<Index>::SparseMatrix(const Problem& params) 
     : params_(params)
 {
+    // a_ and colidx_ are sized by the counting pass in sparse_matrix_assembly
+    rowstr_.resize(params_.na + 1);
+    
+    allocate_vectors();
+    make_matrix();
+    prepare_spmv();
+}
+
+template <std::signed_integral Index>
+SparseMatrix<Index>::SparseMatrix(const Problem& params, CsrMatrix<Index> csr)
+    : params_(params),
+      a_(std::move(csr.a)),
+      colidx_(std::move(csr.colidx)),
+      rowstr_(std::move(csr.rowstr))
+{
+    allocate_vectors();
+    prepare_spmv();
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::allocate_vectors() {
     const auto na = params_.na;
-    const auto nz = na * (params_.nonzer + 1) * (params_.nonzer + 1);
+    const auto width = params_.block;
+    
+    x_.resize((na + 2) * width);
+    z_.resize((na + 2) * width);
+    p_.resize((na + 2) * width);
+    q_.resize((na + 2) * width);
+    r_.resize((na + 2) * width);
+    
+    if (params_.cg == CgMethod::pipelined) {
+        w_.resize(na + 2);
+        w_next_.resize(na + 2);
+        s_.resize(na + 2);
+        t_.resize(na + 2);
+    }
+    if (params_.preconditioner != PreconditionerKind::none || params_.tolerance > 0.0) {
+        y_.resize(na + 2);
+    }
+    if (params_.cg == CgMethod::sstep) {
+        basis_.assign((na + 2) * (2 * params_.sstep + 1), 0.0);
+    }
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::prepare_spmv() {
+    if (params_.spmv == SpmvKernel::sell) {
+        sell_.build(rowstr_, colidx_, a_, params_.sell_sigma, params_.sell_isa);
+    } else {
+        sell_ = SellMatrix<Index>{};
+    }
+    
+    if (params_.spmv == SpmvKernel::symmetric) {
+        symmetric_.build(rowstr_, colidx_, a_);
+    } else {
+        symmetric_ = SymmetricMatrix<Index>{};
+    }
+    
+    if (params_.spmv == SpmvKernel::binned) {
+        binned_.build(rowstr_, colidx_, a_);
+    } else {
+        binned_ = BinnedMatrix<Index>{};
+    }
+    
+    if (params_.spmv == SpmvKernel::tiled) {
+        tiled_.build(rowstr_, colidx_, a_, params_.spmv_tile > 0
+            ? params_.spmv_tile : TiledMatrix<Index>::default_tile_cols(npb::utils::last_level_cache_bytes()));
+    } else {
+        tiled_ = TiledMatrix<Index>{};
+    }
+    
+    if (params_.spmv == SpmvKernel::prefetch) {
+        calibrate_prefetch();
+    } else {
+        prefetch_sweep_.clear();
+    }
+    
+    a_fp32_.clear();
+    a_bf16_.clear();
+    if (params_.precision == Precision::fp32) {
+        a_fp32_.assign(a_.begin(), a_.end());
+    } else if (params_.precision == Precision::bf16) {
+        a_bf16_.resize(a_.size());
+        std::ranges::transform(a_, a_bf16_.begin(), [](const double v) { return to_bf16(static_cast<float>(v)); });
+    }
+}
+
+template <std::signed_integral Index>
+std::string SparseMatrix<Index>::spmv_description() const {
+    if (params_.spmv == SpmvKernel::merge) {
+        return "CSR merge-path";
+    }
+    if (params_.spmv == SpmvKernel::symmetric) {
+        std::ostringstream out;
+        out << "CSR symmetric (upper triangle, "
+            << std::fixed << std::setprecision(1) << 100.0 * symmetric_.nonzeros() / rowstr_[params_.na]
+            << "% of nonzeros)";
+        return out.str();
+    }
+    if (params_.spmv == SpmvKernel::prefetch && prefetch_distance_ == 0) {
+        return "CSR (prefetch off: no distance beat csr in calibration)";
+    }
+    if (params_.spmv == SpmvKernel::prefetch) {
+        std::ostringstream out;
+        out << "CSR prefetch (distance " << prefetch_distance_
+            << (params_.prefetch_distance > 0 ? "" : ", calibrated") << ", "
+            << std::fixed << std::setprecision(2) << prefetch_speedup_ << "x over csr)";
+        return out.str();
+    }
+    if (params_.spmv == SpmvKernel::binned) {
+        std::ostringstream out;
+        out << "CSR row-length classes (" << binned_.used_classes() << " widths up to "
+            << BinnedMatrix<Index>::max_width << ", " << std::fixed << std::setprecision(1)
+            << 100.0 * binned_.padding_ratio() << "% padding, "
+            << binned_.generic_rows() << " generic rows)";
+        return out.str();
+    }
+    if (params_.spmv == SpmvKernel::tiled) {
+        std::ostringstream out;
+        out << "CSR column tiles (" << tiled_.tiles() << (tiled_.tiles() == 1 ? " tile" : " tiles")
+            << " of " << tiled_.tile_cols() << " columns, " << std::fixed << std::setprecision(1);
+        const double slice = static_cast<double>(tiled_.tile_cols() * sizeof(double));
+        if (slice < 1048576.0) {
+            out << slice / 1024.0 << " KiB of p each";
+        } else {
+            out << slice / 1048576.0 << " MiB of p each";
+        }
+        out << (params_.spmv_tile > 0 ? ")" : ", sized from the LLC)");
+        return out.str();
+    }
+    if (params_.spmv != SpmvKernel::sell) {
+        return "CSR";
+    }
+    
+    std::ostringstream out;
+    out << "SELL-" << SellMatrix<Index>::chunk_size << "-" << sell_.sigma()
+        << " (" << sell_isa_name(sell_.isa()) << ", "
+        << std::fixed << std::setprecision(1) << 100.0 * sell_.padding_ratio() << "% padding)";
+    return out.str();
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmv(const double* in, double* out) noexcept {
+    if (params_.spmv == SpmvKernel::sell) {
+        sell_.multiply(in, out);
+        return;
+    }
+    if (params_.spmv == SpmvKernel::merge) {
+        spmv_merge(in, out);
+        return;
+    }
+    if (params_.spmv == SpmvKernel::symmetric) {
+        symmetric_.multiply(in, out);
+        return;
+    }
+    if (params_.spmv == SpmvKernel::binned) {
+        binned_.multiply(in, out);
+        return;
+    }
+    if (params_.spmv == SpmvKernel::tiled) {
+        tiled_.multiply(in, out);
+        return;
+    }
+    if (params_.spmv == SpmvKernel::prefetch && prefetch_distance_ > 0) {
+        spmv_prefetch(in, out, prefetch_distance_);
+        return;
+    }
+    
+    spmv_csr(in, out);
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmv_csr(const double* in, double* out) noexcept {
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        double suml = 0.0;
+        const auto row_start = rowstr_[j];
+        const auto row_end = rowstr_[j+1];
+        
+        for (int64_t k = row_start; k < row_end; k++) {
+            suml += a_[k] * in[colidx_[k]];
+        }
+        out[j] = suml;
+    }
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmv_low(const double* in, double* out) noexcept {
+    if (params_.precision == Precision::bf16) {
+        #pragma omp for nowait schedule(static)
+        for (int64_t j = 0; j < params_.na; j++) {
+            double suml = 0.0;
+            for (int64_t k = rowstr_[j]; k < rowstr_[j+1]; k++) {
+                suml += from_bf16(a_bf16_[k]) * in[colidx_[k]];
+            }
+            out[j] = suml;
+        }
+        return;
+    }
+    
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        double suml = 0.0;
+        for (int64_t k = rowstr_[j]; k < rowstr_[j+1]; k++) {
+            suml += static_cast<double>(a_fp32_[k]) * in[colidx_[k]];
+        }
+        out[j] = suml;
+    }
+}
+
+// The CSR loop with the same rows and schedule, so it is nowait too. Each
+// gather also prefetches the input entry needed distance nonzeros later,
+// which the hardware prefetchers cannot predict; near the end of a row the
+// target lies in one of the next rows. Only the last distance nonzeros of
+// the matrix go without.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmv_prefetch(const double* in, double* out, const int64_t distance) noexcept {
+    const int64_t prefetch_end = rowstr_[params_.na] - distance;
+    
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        double suml = 0.0;
+        const int64_t row_start = rowstr_[j];
+        const int64_t row_end = rowstr_[j+1];
+        const int64_t split = std::clamp(prefetch_end, row_start, row_end);
+        
+        for (int64_t k = row_start; k < split; k++) {
+            __builtin_prefetch(&in[colidx_[k + distance]]);
+            suml += a_[k] * in[colidx_[k]];
+        }
+        for (int64_t k = split; k < row_end; k++) {
+            suml += a_[k] * in[colidx_[k]];
+        }
+        out[j] = suml;
+    }
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::calibrate_prefetch() {
+    constexpr std::array<int64_t, 7> candidates = {4, 8, 16, 32, 64, 128, 256};
+    constexpr int repetitions = 4;
+    
+    std::vector<int64_t> distances = {0};
+    if (params_.prefetch_distance > 0) {
+        distances.push_back(params_.prefetch_distance);
+    } else {
+        distances.insert(distances.end(), candidates.begin(), candidates.end());
+    }
+    
+    std::vector<double> in(params_.na + 2, 1.0);
+    std::vector<double> out(params_.na + 2, 0.0);
+    std::vector<double> seconds(distances.size(), std::numeric_limits<double>::max());
+    
+    #pragma omp parallel num_threads(params_.num_threads)
+    for (size_t d = 0; d < distances.size(); d++) {
+        for (int rep = 0; rep < repetitions; rep++) {
+            #pragma omp barrier
+            const auto start = std::chrono::steady_clock::now();
+            if (distances[d] == 0) {
+                spmv_csr(in.data(), out.data());
+            } else {
+                spmv_prefetch(in.data(), out.data(), distances[d]);
+            }
+            #pragma omp barrier
+            #pragma omp master
+            seconds[d] = std::min(seconds[d], std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    
+    prefetch_sweep_.clear();
+    for (size_t d = 0; d < distances.size(); d++) {
+        prefetch_sweep_.emplace_back(distances[d], seconds[d]);
+    }
+    
+    // Calibration may keep the CSR loop; a distance given by the user is
+    // always used
+    const auto first = params_.prefetch_distance > 0 ? prefetch_sweep_.begin() + 1 : prefetch_sweep_.begin();
+    const auto best = std::min_element(first, prefetch_sweep_.end(),
+        [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+    prefetch_distance_ = best->first;
+    prefetch_speedup_ = prefetch_sweep_.front().second / best->second;
+}
+
+// Gershgorin interval of A, the basis recurrence and change of basis it
+// gives, and the matrix-powers tile plan of the s-step CG
+template <std::signed_integral Index>
+void SparseMatrix<Index>::prepare_sstep(const int nthreads) {
+    const int64_t s = params_.sstep;
+    const int64_t width = 2 * s + 1;
+    
+    // Gershgorin interval holding the spectrum of A
+    double lower = std::numeric_limits<double>::max();
+    double upper = std::numeric_limits<double>::lowest();
+    #pragma omp parallel for reduction(min:lower) reduction(max:upper) num_threads(nthreads)
+    for (int64_t i = 0; i < params_.na; i++) {
+        double diagonal = 0.0;
+        double radius = 0.0;
+        for (int64_t k = rowstr_[i]; k < rowstr_[i+1]; k++) {
+            if (colidx_[k] == i) {
+                diagonal += a_[k];
+            } else {
+                radius += std::abs(a_[k]);
+            }
+        }
+        lower = std::min(lower, diagonal - radius);
+        upper = std::max(upper, diagonal + radius);
+    }
+    sstep_norm_ = std::max(std::abs(lower), std::abs(upper));
+    
+    using Step = typename MatrixPowers<Index>::Step;
+    sstep_steps_.resize(s);
+    if (params_.sstep_basis == SstepBasis::chebyshev) {
+        // T_j((A - c) / h), centred on and scaled to the interval
+        const double center = 0.5 * (upper + lower);
+        const double half_width = upper > lower ? 0.5 * (upper - lower) : 1.0;
+        for (int64_t j = 1; j <= s; j++) {
+            sstep_steps_[j - 1] = j == 1
+                ? Step{1.0 / half_width, -center / half_width, 0.0}
+                : Step{2.0 / half_width, -2.0 * center / half_width, -1.0};
+        }
+    } else {
+        const double radius = std::max({std::abs(lower), std::abs(upper), 1.0e-300});
+        std::fill(sstep_steps_.begin(), sstep_steps_.end(), Step{1.0 / radius, 0.0, 0.0});
+    }
+    
+    // Inverting the recurrence, A V_{j-1} = (V_j - shift V_{j-1} - back V_{j-2}) / scale
+    // in each chain; the last vector of a chain has no column
+    sstep_change_.assign(width * width, 0.0);
+    for (const int64_t chain : {int64_t{0}, s + 1}) {
+        const int64_t length = chain == 0 ? s : s - 1;
+        for (int64_t j = 1; j <= length; j++) {
+            const Step& step = sstep_steps_[j - 1];
+            const int64_t column = chain + j - 1;
+            sstep_change_[(column + 1) * width + column] = 1.0 / step.scale;
+            sstep_change_[column * width + column] = -step.shift / step.scale;
+            if (j > 1) {
+                sstep_change_[(column - 1) * width + column] = -step.back / step.scale;
+            }
+        }
+    }
+    
+    matrix_powers_.plan(params_.na, rowstr_[params_.na], bandwidth(), s, nthreads,
+                        npb::utils::last_level_cache_bytes());
+}
+
+// Streaming model: every stored value and index is read once, the row
+// pointers and output once per row, and each gather of the input vector
+// costs a full 8-byte load, as when it does not stay in cache
+template <std::signed_integral Index>
+PhaseTraffic SparseMatrix<Index>::spmv_traffic() const noexcept {
+    constexpr double value_bytes = sizeof(double);
+    constexpr double index_bytes = sizeof(Index);
+    const double na = static_cast<double>(params_.na);
+    const double nnz = static_cast<double>(rowstr_[params_.na]);
+    
+    PhaseTraffic traffic;
+    traffic.flops = 2.0 * nnz;
+    
+    if (params_.spmv == SpmvKernel::sell) {
+        // Padded slots are streamed and gathered like nonzeros; each lane
+        // also reads its row from the permutation
+        const double slots = static_cast<double>(sell_.slots());
+        traffic.bytes = slots * (2.0 * value_bytes + index_bytes) + na * (index_bytes + value_bytes);
+    } else if (params_.spmv == SpmvKernel::binned) {
+        // Padded slots are streamed and gathered like nonzeros; each row
+        // reads its original index and writes its output
+        const double slots = static_cast<double>(binned_.slots());
+        traffic.bytes = slots * (2.0 * value_bytes + index_bytes) + na * (index_bytes + value_bytes);
+    } else if (params_.spmv == SpmvKernel::tiled) {
+        // Every tile reads its row pointers, and every tile after the first
+        // reads back the outputs the previous one wrote
+        const double tiles = static_cast<double>(tiled_.tiles());
+        traffic.bytes = nnz * (2.0 * value_bytes + index_bytes) + static_cast<double>(tiled_.pointers()) * index_bytes
+                      + (2.0 * tiles - 1.0) * na * value_bytes;
+    } else if (params_.spmv == SpmvKernel::symmetric) {
+        // Every stored entry gathers x[j], and off-diagonal ones update y[j]
+        // as well. Each tile reads its row pointers, and each nonempty tile
+        // row reads x[i] and updates its row sum; y is cleared once, and
+        // the row sums are read once and added to it.
+        const double stored = static_cast<double>(symmetric_.nonzeros());
+        const double tile_rows = static_cast<double>(symmetric_.tile_rows());
+        traffic.bytes = stored * (value_bytes + index_bytes) + static_cast<double>(symmetric_.pointers()) * index_bytes
+                      + stored * value_bytes + 2.0 * (stored - na) * value_bytes
+                      + 3.0 * tile_rows * value_bytes + 4.0 * na * value_bytes;
+    } else {
+        traffic.bytes = nnz * (2.0 * value_bytes + index_bytes) + (na + 1.0) * index_bytes + na * value_bytes;
+    }
+    
+    return traffic;
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::phase_start(const npb::utils::TimerManager::TimerID id) noexcept {
+    if (!timed_) {
+        return;
+    }
+    
+    if (phase_timer_ != nullptr) {
+        #pragma omp barrier
+        #pragma omp master
+        phase_timer_->start(id);
+    }
+    
+    profiler_->begin(phase_regions_[id - npb::utils::TimerManager::T_SPMV], npb::utils::thread_id());
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::phase_stop(
+    const npb::utils::TimerManager::TimerID id,
+    const PhaseTraffic& traffic
+) noexcept {
+    if (!timed_) {
+        return;
+    }
+    
+    // Ended before the barrier, so waiting for other threads shows up as
+    // imbalance rather than phase time
+    profiler_->end(phase_regions_[id - npb::utils::TimerManager::T_SPMV], npb::utils::thread_id());
+    
+    if (phase_timer_ == nullptr) {
+        return;
+    }
+    
+    #pragma omp barrier
+    #pragma omp master
+    {
+        phase_timer_->stop(id);
+        auto& total = phase_traffic_[id - npb::utils::TimerManager::T_SPMV];
+        total.bytes += traffic.bytes;
+        total.flops += traffic.flops;
+    }
+}
+
+// Merge-path search (Merrill and Garland): the path merges the row ends
+// rowstr[1..na] with the nonzero indices 0..nnz-1, and diagonal d holds the
+// points (row, nz) with row + nz = d. Returns the point where the path
+// crosses it.
+template <std::signed_integral Index>
+std::pair<int64_t, int64_t> SparseMatrix<Index>::merge_path_search(const int64_t diagonal) const noexcept {
+    const int64_t nnz = rowstr_[params_.na];
+    int64_t lo = std::max<int64_t>(0, diagonal - nnz);
+    int64_t hi = std::min<int64_t>(diagonal, params_.na);
+    
+    while (lo < hi) {
+        const int64_t mid = lo + (hi - lo) / 2;
+        if (rowstr_[mid + 1] > diagonal - mid - 1) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    
+    return {lo, diagonal - lo};
+}
+
+// Each thread takes an equal share of rows plus nonzeros, so long rows no
+// longer land on a few threads. A thread writes the rows it finishes and
+// keeps the partial sum of the row it stops inside as a carry-out; the
+// carries are added after the barrier, in thread order.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmv_merge(const double* in, double* out) noexcept {
+    #ifdef _OPENMP
+    const int tid = omp_get_thread_num();
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int tid = 0;
+    const int nthreads = 1;
+    #endif
+    
+    const int64_t path_length = params_.na + rowstr_[params_.na];
+    const int64_t items_per_thread = (path_length + nthreads - 1) / nthreads;
+    const int64_t diagonal_begin = std::min(items_per_thread * tid, path_length);
+    const int64_t diagonal_end = std::min(diagonal_begin + items_per_thread, path_length);
+    
+    auto [row, k] = merge_path_search(diagonal_begin);
+    const auto [row_end, k_end] = merge_path_search(diagonal_end);
+    
+    for (; row < row_end; row++) {
+        double suml = 0.0;
+        const int64_t row_stop = rowstr_[row + 1];
+        for (; k < row_stop; k++) {
+            suml += a_[k] * in[colidx_[k]];
+        }
+        out[row] = suml;
+    }
+    
+    double carry = 0.0;
+    for (; k < k_end; k++) {
+        carry += a_[k] * in[colidx_[k]];
+    }
+    carries_[tid] = {row_end, carry};
+    
+    #pragma omp barrier
+    
+    #pragma omp single
+    for (int t = 0; t < nthreads; t++) {
+        if (carries_[t].row < params_.na) {
+            out[carries_[t].row] += carries_[t].value;
+        }
+    }
+}
+
+template <std::signed_integral Index>
+std::vector<int64_t> SparseMatrix<Index>::thread_nonzeros(const SpmvKernel kernel, const int nthreads) const {
+    std::vector<int64_t> counts(nthreads);
+    
+    for (int t = 0; t < nthreads; t++) {
+        if (kernel == SpmvKernel::merge) {
+            const int64_t path_length = params_.na + rowstr_[params_.na];
+            const int64_t items_per_thread = (path_length + nthreads - 1) / nthreads;
+            const int64_t diagonal_begin = std::min(items_per_thread * t, path_length);
+            const int64_t diagonal_end = std::min(diagonal_begin + items_per_thread, path_length);
+            counts[t] = merge_path_search(diagonal_end).second - merge_path_search(diagonal_begin).second;
+        } else {
+            // Row blocks of schedule(static): the first na % nthreads get one extra row
+            const int64_t rows = params_.na / nthreads;
+            const int64_t extra = params_.na % nthreads;
+            const int64_t row_begin = t * rows + std::min<int64_t>(t, extra);
+            const int64_t row_end = row_begin + rows + (t < extra ? 1 : 0);
+            counts[t] = rowstr_[row_end] - rowstr_[row_begin];
+        }
+    }
+    
+    return counts;
+}
+
+template <std::signed_integral Index>
+double SparseMatrix<Index>::run_benchmark(
+    npb::utils::TimerManager& timer,
+    npb::utils::RegionProfiler& profiler,
+    npb::utils::PerfCounters& counters
+) {
+    #ifdef _OPENMP
+    omp_set_num_threads(params_.num_threads);
+    #endif
+    
+    #ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+    #else
+    const int max_threads = 1;
+    #endif
+    
+    profiler.reset(max_threads);
+    profiler_ = &profiler;
+    benchmark_region_ = profiler.region("benchmark");
+    conj_grad_region_ = profiler.region("conj_grad", benchmark_region_);
+    norms_region_ = profiler.region("norms", benchmark_region_);
+    counters.reset(max_threads);
+    counters_ = &counters;
+    
+    if (params_.block > 1) {
+        // Room for the 2 * block norms, in whole 64-byte lines per slot
+        block_stride_ = (2 * params_.block + 7) / 8 * 8;
+        block_partials_.assign(2 * max_threads * block_stride_, 0.0);
+        return run_benchmark_block(timer);
+    }
+    
+    if (params_.cg == CgMethod::classic) {
+        phase_regions_ = {
+            profiler.region("spmv", conj_grad_region_),
+            profiler.region("dot", conj_grad_region_),
+            profiler.region("axpy", conj_grad_region_),
+        };
+    }
+    
+    if (params_.cg == CgMethod::pipelined) {
+        partials_.assign(2 * max_threads, {});
+    }
+    if (params_.cg == CgMethod::sstep) {
+        // The packed upper triangle of the Gram matrix, reduced like the
+        // block-mode norms
+        const int64_t width = 2 * params_.sstep + 1;
+        block_stride_ = (width * (width + 1) / 2 + 7) / 8 * 8;
+        block_partials_.assign(2 * max_threads * block_stride_, 0.0);
+        prepare_sstep(max_threads);
+    }
+    if (params_.preconditioner != PreconditionerKind::none || params_.tolerance > 0.0) {
+        const auto start = std::chrono::steady_clock::now();
+        preconditioner_.build(params_.preconditioner, rowstr_, colidx_, a_, max_threads);
+        precondition_stats_.setup_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (params_.spmv == SpmvKernel::merge) {
+        carries_.assign(max_threads, {});
+    }
+    if (params_.spmv == SpmvKernel::symmetric) {
+        symmetric_.partition(max_threads);
+    }
+    
+    auto initialize_vectors = [this]() {
+        std::fill(x_.begin(), x_.begin() + params_.na + 1, 1.0);
+        std::fill_n(q_.begin(), params_.na, 0.0);
+        std::fill_n(z_.begin(), params_.na, 0.0);
+        std::fill_n(r_.begin(), params_.na, 0.0);
+        std::fill_n(p_.begin(), params_.na, 0.0);
+    };
+    
+    #pragma omp parallel
+    {
+        const int tid = npb::utils::thread_id();
+        npb::utils::ScopedRegion benchmark_scope(profiler, benchmark_region_, tid);
+        npb::utils::ScopedCounters benchmark_counters(counters, tid);
+        
+        initialize_vectors();
+        
+        #pragma omp single
+        zeta_ = 0.0;
+
+        conjugate_gradient();
+        
+        compute_norms_and_normalize();
+
+        initialize_vectors();
+
+        #pragma omp single
+        {
+            zeta_ = 0.0;
+            timed_ = params_.cg == CgMethod::classic || params_.cg == CgMethod::sstep;
+            if (params_.phase_timers) {
+                phase_timer_ = &timer;
+            }
+        }
+        
+        for (int it = 1; it <= params_.max_iter; it++) {
+            profiler.begin(conj_grad_region_, tid);
+            const double rnorm = conjugate_gradient();
+            profiler.end(conj_grad_region_, tid);
+
+            profiler.begin(norms_region_, tid);
+            const auto [norm_temp1, norm_factor] = compute_norms_and_normalize();
+            profiler.end(norms_region_, tid);
+            
+            #pragma omp single
+            {
+                zeta_ = params_.shift + 1.0 / norm_temp1;
+                rnorm_ = rnorm;
+                
+                if (it == 1) {
+                    std::cout << "\n   iteration           ||r||                 zeta\n";
+                }
+                std::cout << "    " << std::setw(5) << it << "       " 
+                          << std::setw(20) << std::scientific << std::setprecision(14) << rnorm
+                          << std::setw(20) << std::scientific << std::setprecision(13) << zeta_ << "\n";
+            }
+        }
+    }
+    
+    phase_timer_ = nullptr;
+    timed_ = false;
+    
+    return timer.read(npb::utils::TimerManager::T_BENCH);
+}
+
+// Block mode runs params_.block independent power iterations side by side,
+// so every matrix entry loaded by the SpMM serves all of them. Right-hand
+// side 0 starts from x = 1 as in the reference benchmark and is the one
+// verified; the others start from fixed perturbations of it.
+template <std::signed_integral Index>
+double SparseMatrix<Index>::run_benchmark_block(npb::utils::TimerManager& timer) {
+    const int64_t na = params_.na;
+    const int64_t width = params_.block;
+    
+    auto initialize_vectors = [this, na, width]() {
+        #pragma omp for schedule(static)
+        for (int64_t j = 0; j < na + 1; j++) {
+            for (int64_t v = 0; v < width; v++) {
+                x_[j * width + v] = 1.0 + v * static_cast<double>(j % 13) / 13.0;
+                q_[j * width + v] = 0.0;
+                z_[j * width + v] = 0.0;
+                r_[j * width + v] = 0.0;
+                p_[j * width + v] = 0.0;
+            }
+        }
+    };
+    
+    block_zeta_.assign(width, 0.0);
+    
+    #pragma omp parallel
+    {
+        const int tid = npb::utils::thread_id();
+        npb::utils::ScopedRegion benchmark_scope(*profiler_, benchmark_region_, tid);
+        npb::utils::ScopedCounters benchmark_counters(*counters_, tid);
+        
+        int parity = 0;
+        std::vector<double> rnorm(width);
+        std::vector<double> norms(2 * width);
+        
+        // norms[v] = x.z and norms[width + v] = z.z, then x = z / ||z||
+        auto compute_norms_and_normalize = [&]() {
+            std::fill(norms.begin(), norms.end(), 0.0);
+            
+            #pragma omp for nowait schedule(static)
+            for (int64_t j = 0; j < na; j++) {
+                for (int64_t v = 0; v < width; v++) {
+                    norms[v] += x_[j * width + v] * z_[j * width + v];
+                    norms[width + v] += z_[j * width + v] * z_[j * width + v];
+                }
+            }
+            block_allreduce(norms, parity);
+            
+            #pragma omp for schedule(static)
+            for (int64_t j = 0; j < na; j++) {
+                for (int64_t v = 0; v < width; v++) {
+                    x_[j * width + v] = (1.0 / std::sqrt(norms[width + v])) * z_[j * width + v];
+                }
+            }
+        };
+        
+        initialize_vectors();
+        conjugate_gradient_block(rnorm, parity);
+        compute_norms_and_normalize();
+        initialize_vectors();
+        
+        for (int it = 1; it <= params_.max_iter; it++) {
+            profiler_->begin(conj_grad_region_, tid);
+            conjugate_gradient_block(rnorm, parity);
+            profiler_->end(conj_grad_region_, tid);
+            
+            profiler_->begin(norms_region_, tid);
+            compute_norms_and_normalize();
+            profiler_->end(norms_region_, tid);
+            
+            #pragma omp single
+            {
+                for (int64_t v = 0; v < width; v++) {
+                    block_zeta_[v] = params_.shift + 1.0 / norms[v];
+                }
+                zeta_ = block_zeta_[0];
+                rnorm_ = rnorm[0];
+                
+                if (it == 1) {
+                    std::cout << "\n   iteration           ||r||                 zeta\n";
+                }
+                std::cout << "    " << std::setw(5) << it << "       " 
+                          << std::setw(20) << std::scientific << std::setprecision(14) << rnorm[0]
+                          << std::setw(20) << std::scientific << std::setprecision(13) << zeta_ << "\n";
+            }
+        }
+    }
+    
+    return timer.read(npb::utils::TimerManager::T_BENCH);
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::block_allreduce(std::vector<double>& values, int& parity) noexcept {
+    #ifdef _OPENMP
+    const int tid = omp_get_thread_num();
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int tid = 0;
+    const int nthreads = 1;
+    #endif
+    
+    // Alternating halves keep a slot from being rewritten by a fast thread
+    // while a slow one still reads the previous reduction
+    double* slots = block_partials_.data() + parity * nthreads * block_stride_;
+    std::copy(values.begin(), values.end(), slots + tid * block_stride_);
+    
+    #pragma omp barrier
+    
+    std::fill(values.begin(), values.end(), 0.0);
+    for (int t = 0; t < nthreads; t++) {
+        for (size_t v = 0; v < values.size(); v++) {
+            values[v] += slots[t * block_stride_ + v];
+        }
+    }
+    parity ^= 1;
+}
+
+// out = A in for params_.block interleaved vectors; each matrix entry is
+// loaded once and applied to all of them. Same nowait/static contract as
+// the CSR spmv.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::spmm(const double* in, double* out) noexcept {
+    const int64_t width = params_.block;
+    
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        double* out_row = out + j * width;
+        std::fill(out_row, out_row + width, 0.0);
+        
+        for (int64_t k = rowstr_[j]; k < rowstr_[j+1]; k++) {
+            const double a = a_[k];
+            const double* in_row = in + static_cast<int64_t>(colidx_[k]) * width;
+            for (int64_t v = 0; v < width; v++) {
+                out_row[v] += a * in_row[v];
+            }
+        }
+    }
+}
+
+// conjugate_gradient for every right-hand side at once; rnorm receives
+// ||x - A z|| of each
+template <std::signed_integral Index>
+void SparseMatrix<Index>::conjugate_gradient_block(std::vector<double>& rnorm, int& parity) noexcept {
+    constexpr int64_t cgitmax = 25;
+    const int64_t na = params_.na;
+    const int64_t width = params_.block;
+    
+    std::vector<double> rho(width, 0.0);
+    std::vector<double> rho0(width);
+    std::vector<double> d(width);
+    std::vector<double> alpha(width);
+    std::vector<double> beta(width);
+    
+    #pragma omp for schedule(static)
+    for (int64_t j = 0; j < (na + 1) * width; j++) {
+        q_[j] = 0.0;
+        z_[j] = 0.0;
+        r_[j] = x_[j];
+        p_[j] = r_[j];
+    }
+    
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < na; j++) {
+        for (int64_t v = 0; v < width; v++) {
+            rho[v] += r_[j * width + v] * r_[j * width + v];
+        }
+    }
+    block_allreduce(rho, parity);
+    
+    for (int64_t cgit = 1; cgit <= cgitmax; cgit++) {
+        rho0 = rho;
+        std::fill(d.begin(), d.end(), 0.0);
+        std::fill(rho.begin(), rho.end(), 0.0);
+        
+        spmm(p_.data(), q_.data());
+        
+        #pragma omp for nowait schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            for (int64_t v = 0; v < width; v++) {
+                d[v] += p_[j * width + v] * q_[j * width + v];
+            }
+        }
+        block_allreduce(d, parity);
+        
+        for (int64_t v = 0; v < width; v++) {
+            alpha[v] = rho0[v] / d[v];
+        }
+        
+        #pragma omp for nowait schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            for (int64_t v = 0; v < width; v++) {
+                z_[j * width + v] += alpha[v] * p_[j * width + v];
+                r_[j * width + v] -= alpha[v] * q_[j * width + v];
+                rho[v] += r_[j * width + v] * r_[j * width + v];
+            }
+        }
+        block_allreduce(rho, parity);
+        
+        for (int64_t v = 0; v < width; v++) {
+            beta[v] = rho[v] / rho0[v];
+        }
+        
+        #pragma omp for schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            for (int64_t v = 0; v < width; v++) {
+                p_[j * width + v] = r_[j * width + v] + beta[v] * p_[j * width + v];
+            }
+        }
+    }
+    
+    spmm(z_.data(), r_.data());
+    
+    std::fill(rnorm.begin(), rnorm.end(), 0.0);
+    #pragma omp for nowait schedule(static)
+    for (int64_t j = 0; j < na; j++) {
+        for (int64_t v = 0; v < width; v++) {
+            const double suml = x_[j * width + v] - r_[j * width + v];
+            rnorm[v] += suml * suml;
+        }
+    }
+    block_allreduce(rnorm, parity);
+    
+    for (int64_t v = 0; v < width; v++) {
+        rnorm[v] = std::sqrt(rnorm[v]);
+    }
+}
+
+template <std::signed_integral Index>
+std::pair<double, double> SparseMatrix<Index>::compute_norms_and_normalize() noexcept {
+    static double norm_temp1, norm_temp2;
+    
+    #pragma omp single
+    {
+        norm_temp1 = 0.0;
+        norm_temp2 = 0.0;
+    }
+    
+    #pragma omp for reduction(+:norm_temp1, norm_temp2) schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        norm_temp1 += x_[j] * z_[j];
+        norm_temp2 += z_[j] * z_[j];
+    }
+    
+    const double norm_factor = 1.0 / std::sqrt(norm_temp2);
+    const double dot = norm_temp1;
+    
+    #pragma omp for schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        x_[j] = norm_factor * z_[j];
+    }
+    
+    return {dot, norm_factor};
+}
+
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient() noexcept {
+    if (params_.precision != Precision::fp64) {
+        return conjugate_gradient_mixed();
+    }
+    if (params_.preconditioner != PreconditionerKind::none || params_.tolerance > 0.0) {
+        return conjugate_gradient_preconditioned();
+    }
+    switch (params_.cg) {
+    case CgMethod::pipelined:
+        return conjugate_gradient_pipelined();
+    case CgMethod::sstep:
+        return conjugate_gradient_sstep();
+    default:
+        return conjugate_gradient_classic();
+    }
+}
+
+// Ghysels-Vanroose pipelined CG. With w = A r, s = A p and t = A s kept as
+// recurrences, the only SpMV per iteration is A w, and both dot products
+// (r.r, w.r) of the next iteration come out of the same sweep. For the CSR
+// kernel the SpMV and all vector updates are fused row by row, leaving one
+// barrier per iteration; w is double-buffered because the sweep gathers the
+// old w while writing the new one.
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient_pipelined() noexcept {
+    constexpr int64_t cgitmax = 25;
+    
+    #ifdef _OPENMP
+    const int tid = omp_get_thread_num();
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int tid = 0;
+    const int nthreads = 1;
+    #endif
+    
+    static double sum;
+    
+    // Partial sums are added in thread order, so every thread gets the same
+    // gamma = r.r and delta = w.r without another synchronization
+    auto reduce = [&](const int parity) -> std::pair<double, double> {
+        double gamma = 0.0;
+        double delta = 0.0;
+        for (int t = 0; t < nthreads; t++) {
+            gamma += partials_[parity * nthreads + t].gamma;
+            delta += partials_[parity * nthreads + t].delta;
+        }
+        return {gamma, delta};
+    };
+    
+    #pragma omp single nowait
+    sum = 0.0;
+    
+    #pragma omp for schedule(static)
+    for (int64_t j = 0; j < params_.na + 1; j++) {
+        z_[j] = 0.0;
+        r_[j] = x_[j];
+        p_[j] = 0.0;
+        s_[j] = 0.0;
+        t_[j] = 0.0;
+    }
+    
+    double* w = w_.data();
+    double* w_next = w_next_.data();
+    
+    spmv(r_.data(), w);
+    
+    {
+        double gamma = 0.0;
+        double delta = 0.0;
+        #pragma omp for nowait schedule(static)
+        for (int64_t j = 0; j < params_.na; j++) {
+            gamma += r_[j] * r_[j];
+            delta += w[j] * r_[j];
+        }
+        partials_[tid] = {gamma, delta};
+    }
+    
+    #pragma omp barrier
+    
+    double gamma_prev = 0.0;
+    double alpha_prev = 0.0;
+    
+    for (int64_t cgit = 0; cgit < cgitmax; cgit++) {
+        const int parity = static_cast<int>(cgit & 1);
+        const auto [gamma, delta] = reduce(parity);
+        const double beta = cgit > 0 ? gamma / gamma_prev : 0.0;
+        const double alpha = cgit > 0 ? gamma / (delta - beta * gamma / alpha_prev) : gamma / delta;
+        gamma_prev = gamma;
+        alpha_prev = alpha;
+        
+        double gamma_next = 0.0;
+        double delta_next = 0.0;
+        
+        auto update_row = [&](const int64_t j, const double q) {
+            t_[j] = q + beta * t_[j];
+            s_[j] = w[j] + beta * s_[j];
+            p_[j] = r_[j] + beta * p_[j];
+            z_[j] += alpha * p_[j];
+            r_[j] -= alpha * s_[j];
+            w_next[j] = w[j] - alpha * t_[j];
+            gamma_next += r_[j] * r_[j];
+            delta_next += w_next[j] * r_[j];
+        };
+        
+        if (params_.spmv == SpmvKernel::csr) {
+            #pragma omp for nowait schedule(static)
+            for (int64_t j = 0; j < params_.na; j++) {
+                double q = 0.0;
+                for (int64_t k = rowstr_[j]; k < rowstr_[j+1]; k++) {
+                    q += a_[k] * w[colidx_[k]];
+                }
+                update_row(j, q);
+            }
+        } else {
+            spmv(w, q_.data());
+            
+            #pragma omp for nowait schedule(static)
+            for (int64_t j = 0; j < params_.na; j++) {
+                update_row(j, q_[j]);
+            }
+        }
+        
+        partials_[(1 - parity) * nthreads + tid] = {gamma_next, delta_next};
+        std::swap(w, w_next);
+        
+        #pragma omp barrier
+    }
+    
+    spmv(z_.data(), r_.data());
+    
+    #pragma omp for reduction(+:sum) schedule(static)
+    for (int64_t j = 0; j < params_.na; j++) {
+        const double suml = x_[j] - r_[j];
+        sum += suml * suml;
+    }
+    
+    #pragma omp single
+    sum = std::sqrt(sum);
+    
+    return sum;
+}
+
+// Mixed-precision CG with iterative refinement. The inner CG multiplies by
+// the values rounded to float or bfloat16, accumulating in double, and
+// stops once it has reduced the residual about as far as that rounding
+// allows. Each refinement step then recomputes the true residual
+// r = x - A z with the double matrix and restarts the inner CG from it, so
+// z converges to the double-precision solution the reference CG reaches.
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient_mixed() noexcept {
+    constexpr int64_t cgitmax = 25;
+    constexpr int64_t max_refinements = 30;
+    constexpr double refine_tolerance = 1.0e-12;    // ||x - A z|| / ||x||
+    const double inner_tolerance = params_.precision == Precision::bf16 ? 1.0e-2 : 1.0e-6;
+    
+    static double d, rho, rho0, rho_start, rnorm, xnorm;
+    int64_t refinements = 0;
+    int64_t inner_iterations = 0;
+    
+    #pragma omp single nowait
+    rho = 0.0;
+    
+    #pragma omp for
+    for (int64_t j = 0; j < params_.na + 1; j++) {
+        q_[j] = 0.0;
+        z_[j] = 0.0;
+        r_[j] = x_[j];
+        p_[j] = r_[j];
+    }
+    
+    #pragma omp for reduction(+:rho)
+    for (int64_t j = 0; j < params_.na; j++) {
+        rho += r_[j] * r_[j];
+    }
+    
+    #pragma omp single
+    {
+        xnorm = std::sqrt(rho);
+        rnorm = xnorm;
+        rho_start = rho;
+    }
+    
+    while (refinements < max_refinements && rnorm > refine_tolerance * xnorm) {
+        refinements++;
+        
+        // Inner CG on A d = r with the rounded matrix, accumulated into z
+        for (int64_t cgit = 1; cgit <= cgitmax; cgit++) {
+            #pragma omp single nowait
+            {
+                d = 0.0;
+                rho0 = rho;
+                rho = 0.0;
+            }
+            
+            spmv_low(p_.data(), q_.data());
+            
+            #pragma omp for reduction(+:d) schedule(static)
+            for (int64_t j = 0; j < params_.na; j++) {
+                d += p_[j] * q_[j];
+            }
+            
+            const double alpha = rho0 / d;
+            
+            #pragma omp for reduction(+:rho) schedule(static)
+            for (int64_t j = 0; j < params_.na; j++) {
+                z_[j] += alpha * p_[j];
+                r_[j] -= alpha * q_[j];
+                rho += r_[j] * r_[j];
+            }
+            inner_iterations++;
+            
+            // Read before the barrier of the p update, as beta is
+            const double beta = rho / rho0;
+            const bool converged = rho <= inner_tolerance * inner_tolerance * rho_start;
+            
+            #pragma omp for schedule(static)
+            for (int64_t j = 0; j < params_.na; j++) {
+                p_[j] = r_[j] + beta * p_[j];
+            }
+            
+            if (converged) {
+                break;
+            }
+        }
+        
+        // True residual with the double matrix; the next inner CG starts
+        // from it with p = r
+        #pragma omp single nowait
+        rho = 0.0;
+        
+        spmv_csr(z_.data(), q_.data());
+        
+        #pragma omp for reduction(+:rho) schedule(static)
+        for (int64_t j = 0; j < params_.na; j++) {
+            r_[j] = x_[j] - q_[j];
+            p_[j] = r_[j];
+            rho += r_[j] * r_[j];
+        }
+        
+        #pragma omp single
+        {
+            rnorm = std::sqrt(rho);
+            rho_start = rho;
+        }
+    }
+    
+    #pragma omp master
+    if (timed_) {
+        // CSR streaming model as in spmv_traffic, with narrower values for
+        // the inner SpMVs
+        const double na = static_cast<double>(params_.na);
+        const double nnz = static_cast<double>(rowstr_[params_.na]);
+        const double value_bytes = params_.precision == Precision::bf16 ? sizeof(uint16_t) : sizeof(float);
+        const double rows_bytes = (na + 1.0) * sizeof(Index) + na * sizeof(double);
+        const double low_bytes = nnz * (value_bytes + sizeof(Index) + sizeof(double)) + rows_bytes;
+        const double double_bytes = spmv_traffic().bytes;
+        
+        refinement_.solves++;
+        refinement_.refinements += refinements;
+        refinement_.max_refinements = std::max(refinement_.max_refinements, refinements);
+        refinement_.inner_iterations += inner_iterations;
+        refinement_.spmv_bytes += inner_iterations * low_bytes + refinements * double_bytes;
+        refinement_.reference_bytes += (cgitmax + 1) * double_bytes;
+    }
+    
+    return rnorm;
+}
+
+// s-step CG (Chronopoulos-Gear, in the formulation of Carson and Demmel).
+// Each block of s iterations builds the Krylov basis
+// V = [P_0 .. P_s, R_0 .. R_{s-1}] of p and r with the matrix-powers kernel
+// and reduces its Gram matrix G = V^T V once. The s iterations then run on
+// coordinates in V: A V = V B for the change of basis B given by the basis
+// recurrence, so every dot product becomes a small product with G, which
+// each thread evaluates redundantly. z and p are rebuilt from their
+// coordinates at the end of the block, and r is replaced by the true
+// residual x - A z, so the next basis is built from it; the drift of the
+// recursively updated residual from it is recorded. The solve runs all
+// cgitmax iterations like the reference, and stops early only once the
+// true residual is down to the rounding error of A z.
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient_sstep() noexcept {
+    constexpr int64_t cgitmax = 25;
+    const int64_t na = params_.na;
+    const int64_t s = params_.sstep;
+    const int64_t width = 2 * s + 1;
+    const double eps = std::numeric_limits<double>::epsilon();
+    const double gram_floor = 64.0 * eps;
+    double* basis = basis_.data();
+    
+    std::vector<double> packed(width * (width + 1) / 2);
+    std::vector<double> gram(width * width);
+    std::vector<double> p_coef(width);
+    std::vector<double> r_coef(width);
+    std::vector<double> z_coef(width);
+    std::vector<double> ap_coef(width);
+    std::vector<double> g_coef(width);
+    std::vector<double> norms(4);     // ||x - A z||^2, drift^2, ||z||^2, ||x||^2
+    int parity = 0;
+    int64_t blocks = 0;
+    int64_t short_blocks = 0;
+    int64_t done = 0;
+    bool converged = false;
+    bool pending = false;             // the last block ended before updating p
+    double rho_prev = 0.0;
+    double rnorm = 0.0;
+    double xnorm = 0.0;
+    double max_gap = 0.0;
+    
+    // u^T G v
+    auto gram_dot = [&](const std::vector<double>& u, const std::vector<double>& v) {
+        for (int64_t k = 0; k < width; k++) {
+            double row = 0.0;
+            for (int64_t l = 0; l < width; l++) {
+                row += gram[k * width + l] * v[l];
+            }
+            g_coef[k] = row;
+        }
+        double dot = 0.0;
+        for (int64_t k = 0; k < width; k++) {
+            dot += u[k] * g_coef[k];
+        }
+        return dot;
+    };
+    
+    // |u|^T |G| |u|, the scale of the rounding error in u^T G u
+    auto gram_magnitude = [&](const std::vector<double>& u) {
+        double magnitude = 0.0;
+        for (int64_t k = 0; k < width; k++) {
+            for (int64_t l = 0; l < width; l++) {
+                magnitude += std::abs(u[k] * gram[k * width + l] * u[l]);
+            }
+        }
+        return magnitude;
+    };
+    
+    // p = r = x as level 0 of both chains
+    #pragma omp for schedule(static)
+    for (int64_t j = 0; j < na + 1; j++) {
+        z_[j] = 0.0;
+        basis[j * width] = x_[j];
+        basis[j * width + s + 1] = x_[j];
+    }
+    
+    while (done < cgitmax && !converged) {
+        const int64_t steps = std::min(s, cgitmax - done);
+        
+        matrix_powers_.compute(rowstr_, colidx_, a_, basis, sstep_steps_, steps);
+        
+        std::fill(packed.begin(), packed.end(), 0.0);
+        #pragma omp for nowait schedule(static)
+        for (int64_t i = 0; i < na; i++) {
+            const double* row = basis + i * width;
+            int64_t k = 0;
+            for (int64_t u = 0; u < width; u++) {
+                for (int64_t v = u; v < width; v++) {
+                    packed[k++] += row[u] * row[v];
+                }
+            }
+        }
+        block_allreduce(packed, parity);
+        blocks++;
+        
+        for (int64_t u = 0, k = 0; u < width; u++) {
+            for (int64_t v = u; v < width; v++, k++) {
+                gram[u * width + v] = packed[k];
+                gram[v * width + u] = packed[k];
+            }
+        }
+        
+        // The CG recurrences on coordinates: p = e_0, r = e_{s+1}, z = 0
+        std::fill(p_coef.begin(), p_coef.end(), 0.0);
+        std::fill(r_coef.begin(), r_coef.end(), 0.0);
+        std::fill(z_coef.begin(), z_coef.end(), 0.0);
+        p_coef[0] = 1.0;
+        r_coef[s + 1] = 1.0;
+        double rho = gram_dot(r_coef, r_coef);
+        
+        for (int64_t step = 0; step < steps; step++) {
+            for (int64_t k = 0; k < width; k++) {
+                double row = 0.0;
+                for (int64_t l = 0; l < width; l++) {
+                    row += sstep_change_[k * width + l] * p_coef[l];
+                }
+                ap_coef[k] = row;
+            }
+            
+            const double alpha = rho / gram_dot(p_coef, ap_coef);
+            for (int64_t k = 0; k < width; k++) {
+                z_coef[k] += alpha * p_coef[k];
+                r_coef[k] -= alpha * ap_coef[k];
+            }
+            done++;
+            
+            // Once r^T G r sinks into the rounding error of G it no longer
+            // resolves r and beta would be noise. End the block here and
+            // take beta from the true residual at the boundary instead.
+            const double rho_next = gram_dot(r_coef, r_coef);
+            if (rho_next <= gram_floor * gram_magnitude(r_coef)) {
+                pending = true;
+                rho_prev = rho;
+                short_blocks++;
+                break;
+            }
+            const double beta = rho_next / rho;
+            rho = rho_next;
+            for (int64_t k = 0; k < width; k++) {
+                p_coef[k] = r_coef[k] + beta * p_coef[k];
+            }
+        }
+        
+        // Back to vectors; each row reads and writes only its own entries
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < na; i++) {
+            double* row = basis + i * width;
+            double dz = 0.0;
+            double p = 0.0;
+            double r = 0.0;
+            for (int64_t k = 0; k < width; k++) {
+                dz += z_coef[k] * row[k];
+                p += p_coef[k] * row[k];
+                r += r_coef[k] * row[k];
+            }
+            z_[i] += dz;
+            row[0] = p;
+            row[s + 1] = r;
+        }
+        
+        // Residual replacement, with the same static rows as the SpMV; the
+        // reduction's barrier completes level 0 for the next block
+        spmv_csr(z_.data(), r_.data());
+        
+        std::fill(norms.begin(), norms.end(), 0.0);
+        #pragma omp for nowait schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            double* row = basis + j * width;
+            const double residual = x_[j] - r_[j];
+            const double drift = residual - row[s + 1];
+            row[s + 1] = residual;
+            norms[0] += residual * residual;
+            norms[1] += drift * drift;
+            norms[2] += z_[j] * z_[j];
+            norms[3] += x_[j] * x_[j];
+        }
+        block_allreduce(norms, parity);
+        
+        rnorm = std::sqrt(norms[0]);
+        xnorm = std::sqrt(norms[3]);
+        max_gap = std::max(max_gap, std::sqrt(norms[1]));
+        
+        // x - A z is not computed more accurately than the rounding of
+        // A z, about eps (||x|| + ||A|| ||z||); every thread holds the
+        // same sums, so all take the same branch
+        if (rnorm <= eps * (xnorm + sstep_norm_ * std::sqrt(norms[2]))) {
+            converged = true;
+        } else if (pending) {
+            const double beta = norms[0] / rho_prev;
+            #pragma omp for schedule(static)
+            for (int64_t j = 0; j < na; j++) {
+                double* row = basis + j * width;
+                row[0] = row[s + 1] + beta * row[0];
+            }
+            pending = false;
+        }
+    }
+    
+    #pragma omp single
+    if (timed_) {
+        sstep_stats_.solves++;
+        sstep_stats_.blocks += blocks;
+        sstep_stats_.short_blocks += short_blocks;
+        sstep_stats_.iterations += done;
+        sstep_stats_.max_gap = std::max(sstep_stats_.max_gap, max_gap / xnorm);
+        sstep_stats_.max_residual = std::max(sstep_stats_.max_residual, rnorm / xnorm);
+    }
+    
+    return rnorm;
+}
+
+// Preconditioned CG with a residual stopping test. With params_.tolerance
+// set, a solve stops as soon as the recursively updated residual satisfies
+// ||r|| <= tolerance ||x||, or after params_.cg_iterations iterations;
+// without it, every solve runs all params_.cg_iterations.
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient_preconditioned() noexcept {
+    const int64_t na = params_.na;
+    
+    static double d, sum, rho, rho0, rr, xx;
+    std::chrono::steady_clock::time_point start;
+    int64_t iterations = 0;
+    bool converged = false;
+    
+    #pragma omp master
+    start = std::chrono::steady_clock::now();
+    
+    #pragma omp single nowait
+    {
+        rho = 0.0;
+        xx = 0.0;
+        sum = 0.0;
+    }
+    
+    #pragma omp for
+    for (int64_t j = 0; j < na + 1; j++) {
+        q_[j] = 0.0;
+        z_[j] = 0.0;
+        r_[j] = x_[j];
+    }
     
-    a_.resize(nz);
-    colidx_.resize(nz);
-    rowstr_.resize(na + 1);
+    preconditioner_.apply(rowstr_, colidx_, r_.data(), y_.data());
     
-    x_.resize(na + 2);
-    z_.resize(na + 2);
-    p_.resize(na + 2);
-    q_.resize(na + 2);
-    r_.resize(na + 2);
+    #pragma omp for reduction(+:rho, xx) schedule(static)
+    for (int64_t j = 0; j < na; j++) {
+        p_[j] = y_[j];
+        rho += r_[j] * y_[j];
+        xx += r_[j] * r_[j];
+    }
     
-    make_matrix();
-}
-
-double SparseMatrix::run_benchmark(npb::utils::TimerManager& timer) {
-    #ifdef _OPENMP
-    omp_set_num_threads(params_.num_threads);
-    #endif
+    const double xnorm = std::sqrt(xx);
     
-    auto initialize_vectors = [this]() {
-        std::fill(x_.begin(), x_.begin() + params_.na + 1, 1.0);
-        std::fill_n(q_.begin(), params_.na, 0.0);
-        std::fill_n(z_.begin(), params_.na, 0.0);
-        std::fill_n(r_.begin(), params_.na, 0.0);
-        std::fill_n(p_.begin(), params_.na, 0.0);
-    };
-
-    auto compute_norms_and_normalize = [this]() -> std::pair<double, double> {
-        double norm_temp1 = 0.0;
-        double norm_temp2 = 0.0;
+    for (int64_t cgit = 1; cgit <= params_.cg_iterations; cgit++) {
+        #pragma omp single nowait
+        {
+            d = 0.0;
+            rho0 = rho;
+            rho = 0.0;
+            rr = 0.0;
+        }
         
-        for (int64_t j = 0; j < params_.na; j++) {
-            norm_temp1 += x_[j] * z_[j];
-            norm_temp2 += z_[j] * z_[j];
+        spmv(p_.data(), q_.data());
+        
+        #pragma omp for reduction(+:d) schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            d += p_[j] * q_[j];
         }
         
-        const double norm_factor = 1.0 / std::sqrt(norm_temp2);
+        const double alpha = rho0 / d;
         
-        for (int64_t j = 0; j < params_.na; j++) {
-            x_[j] = norm_factor * z_[j];
+        #pragma omp for reduction(+:rr) schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            z_[j] += alpha * p_[j];
+            r_[j] -= alpha * q_[j];
+            rr += r_[j] * r_[j];
         }
+        iterations++;
         
-        return {norm_temp1, norm_factor};
-    };
-    
-    #pragma omp parallel
-    {
-        initialize_vectors();
+        if (params_.tolerance > 0.0 && std::sqrt(rr) <= params_.tolerance * xnorm) {
+            converged = true;
+            break;
+        }
         
-        #pragma omp single
-        zeta_ = 0.0;
-
-        conjugate_gradient();
+        preconditioner_.apply(rowstr_, colidx_, r_.data(), y_.data());
         
-        #pragma omp single
-        compute_norms_and_normalize();
-
-        initialize_vectors();
-
-        #pragma omp single
-        zeta_ = 0.0;
+        #pragma omp for reduction(+:rho) schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            rho += r_[j] * y_[j];
+        }
         
-        for (int it = 1; it <= params_.max_iter; it++) {
-            timer.start(npb::utils::TimerManager::T_CONJ_GRAD);
-            const double rnorm = conjugate_gradient();
-            timer.stop(npb::utils::TimerManager::T_CONJ_GRAD);
-
-            #pragma omp single
-            {
-                const auto [norm_temp1, norm_factor] = compute_norms_and_normalize();
-                zeta_ = params_.shift + 1.0 / norm_temp1;
-                
-                if (it == 1) {
-                    std::cout << "\n   iteration           ||r||                 zeta\n";
-                }
-                std::cout << "    " << std::setw(5) << it << "       " 
-                          << std::setw(20) << std::scientific << std::setprecision(14) << rnorm
-                          << std::setw(20) << std::scientific << std::setprecision(13) << zeta_ << "\n";
-            }
+        const double beta = rho / rho0;
+        
+        #pragma omp for schedule(static)
+        for (int64_t j = 0; j < na; j++) {
+            p_[j] = y_[j] + beta * p_[j];
         }
     }
     
-    return timer.read(npb::utils::TimerManager::T_BENCH);
+    spmv(z_.data(), r_.data());
+    
+    #pragma omp for reduction(+:sum) schedule(static)
+    for (int64_t j = 0; j < na; j++) {
+        const double suml = x_[j] - r_[j];
+        sum += suml * suml;
+    }
+    
+    #pragma omp single
+    sum = std::sqrt(sum);
+    
+    #pragma omp master
+    if (timed_) {
+        precondition_stats_.solves++;
+        precondition_stats_.iterations += iterations;
+        precondition_stats_.max_iterations = std::max(precondition_stats_.max_iterations, iterations);
+        precondition_stats_.converged += converged ? 1 : 0;
+        precondition_stats_.seconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    return sum;
 }
 
-double SparseMatrix::conjugate_gradient() noexcept {
+template <std::signed_integral Index>
+double SparseMatrix<Index>::conjugate_gradient_classic() noexcept {
     constexpr int64_t cgitmax = 25;
+    using npb::utils::TimerManager;
     
     static double d, sum, rho, rho0;
     
+    // Vector traffic per phase: 8 bytes per element read or written
+    const double n = static_cast<double>(params_.na);
+    const double vector_bytes = sizeof(double) * n;
+    const PhaseTraffic spmv_cost = phase_timer_ ? spmv_traffic() : PhaseTraffic{};
+    
+    // A Matrix Market system may converge within the 25 iterations, and the
+    // next alpha = rho / d would then be 0 / 0. The NPB matrix never gets
+    // there, so its iterations stay as in the reference.
+    const bool guard = !params_.matrix_file.empty();
+    double rho_floor = 0.0;
+    
     #pragma omp single nowait
     {
         rho = 0.0;
@@ -170,10 +1628,12 @@ double SparseMatrix::conjugate_gradient() noexcept {
         p_[j] = r_[j];
     }
     
+    phase_start(TimerManager::T_DOT);
     #pragma omp for reduction(+:rho)
     for (int64_t j = 0; j < params_.na; j++) {
         rho += r_[j] * r_[j];
     }
+    phase_stop(TimerManager::T_DOT, {vector_bytes, 2.0 * n});
     
     for (int64_t cgit = 1; cgit <= cgitmax; cgit++) {
         #pragma omp single nowait
@@ -183,57 +1643,61 @@ double SparseMatrix::conjugate_gradient() noexcept {
             rho = 0.0;
         }
         
-        #pragma omp for nowait schedule(static)
-        for (int64_t j = 0; j < params_.na; j++) {
-            double suml = 0.0;
-            const auto row_start = rowstr_[j];
-            const auto row_end = rowstr_[j+1];
-            
-            for (int64_t k = row_start; k < row_end; k++) {
-                suml += a_[k] * p_[colidx_[k]];
-            }
-            q_[j] = suml;
-        }
+        phase_start(TimerManager::T_SPMV);
+        spmv(p_.data(), q_.data());
+        phase_stop(TimerManager::T_SPMV, spmv_cost);
         
+        phase_start(TimerManager::T_DOT);
         #pragma omp for reduction(+:d) schedule(static)
         for (int64_t j = 0; j < params_.na; j++) {
             d += p_[j] * q_[j];
         }
+        phase_stop(TimerManager::T_DOT, {2.0 * vector_bytes, 2.0 * n});
+        
+        // rho0 and d are read after the reduction's barrier, so every
+        // thread sees the same values and leaves at the same iteration
+        if (guard) {
+            if (cgit == 1) {
+                rho_floor = std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon() * rho0;
+            }
+            if (rho0 <= rho_floor || d == 0.0) {
+                break;
+            }
+        }
         
         const double alpha = rho0 / d;
         
+        // The r.r reduction is fused into the update and counted with it
+        phase_start(TimerManager::T_AXPY);
         #pragma omp for reduction(+:rho) schedule(static)
         for (int64_t j = 0; j < params_.na; j++) {
             z_[j] += alpha * p_[j];
             r_[j] -= alpha * q_[j];
             rho += r_[j] * r_[j];
         }
+        phase_stop(TimerManager::T_AXPY, {6.0 * vector_bytes, 6.0 * n});
         
         const double beta = rho / rho0;
         
+        phase_start(TimerManager::T_AXPY);
         #pragma omp for schedule(static)
         for (int64_t j = 0; j < params_.na; j++) {
             p_[j] = r_[j] + beta * p_[j];
         }
+        phase_stop(TimerManager::T_AXPY, {3.0 * vector_bytes, 2.0 * n});
     }
     
-    #pragma omp for nowait schedule(static)
-    for (int64_t j = 0; j < params_.na; j++) {
-        double suml = 0.0;
-        const auto row_start = rowstr_[j];
-        const auto row_end = rowstr_[j+1];
-        
-        for (int64_t k = row_start; k < row_end; k++) {
-            suml += a_[k] * z_[colidx_[k]];
-        }
-        r_[j] = suml;
-    }
+    phase_start(TimerManager::T_SPMV);
+    spmv(z_.data(), r_.data());
+    phase_stop(TimerManager::T_SPMV, spmv_cost);
     
+    phase_start(TimerManager::T_DOT);
     #pragma omp for reduction(+:sum) schedule(static)
     for (int64_t j = 0; j < params_.na; j++) {
         const double suml = x_[j] - r_[j];
         sum += suml * suml;
     }
+    phase_stop(TimerManager::T_DOT, {2.0 * vector_bytes, 3.0 * n});
     
     #pragma omp single
     sum = std::sqrt(sum);
@@ -241,17 +1705,205 @@ double SparseMatrix::conjugate_gradient() noexcept {
     return sum;
 }
 
-void SparseMatrix::make_matrix() {
-    const auto nz = params_.na * (params_.nonzer + 1) * (params_.nonzer + 1);
+// Reverse Cuthill-McKee ordering of the symmetric pattern rowstr/colidx.
+// Returns perm with perm[new_row] = old_row. Each connected component is
+// numbered breadth-first from a pseudo-peripheral root (George-Liu search),
+// visiting neighbors in increasing degree; the final order is reversed.
+template <std::signed_integral Index>
+static std::vector<int64_t> reverse_cuthill_mckee(
+    const std::vector<Index>& rowstr,
+    const std::vector<Index>& colidx,
+    const int64_t n
+) {
+    constexpr int max_root_sweeps = 8;
+    
+    std::vector<int64_t> degree(n);
+    for (int64_t i = 0; i < n; i++) {
+        degree[i] = rowstr[i+1] - rowstr[i];
+    }
+    
+    std::vector<int64_t> order;
+    order.reserve(n);
+    std::vector<char> numbered(n, 0);
+    std::vector<int64_t> seen(n, -1);    // BFS sweep that last reached a row
+    std::vector<int64_t> level(n, 0);
+    std::vector<int64_t> queue;
+    queue.reserve(n);
+    std::vector<int64_t> neighbors;
+    int64_t sweep = 0;
+    
+    for (int64_t start = 0; start < n; start++) {
+        if (numbered[start]) continue;
+        
+        // Pseudo-peripheral root: move to a minimum-degree row of the last
+        // BFS level until the eccentricity stops growing
+        int64_t root = start;
+        int64_t depth = -1;
+        for (int s = 0; s < max_root_sweeps; s++, sweep++) {
+            queue.clear();
+            queue.push_back(root);
+            seen[root] = sweep;
+            level[root] = 0;
+            for (size_t h = 0; h < queue.size(); h++) {
+                const int64_t u = queue[h];
+                for (int64_t k = rowstr[u]; k < rowstr[u+1]; k++) {
+                    const int64_t v = colidx[k];
+                    if (seen[v] != sweep) {
+                        seen[v] = sweep;
+                        level[v] = level[u] + 1;
+                        queue.push_back(v);
+                    }
+                }
+            }
+            
+            const int64_t eccentricity = level[queue.back()];
+            if (eccentricity <= depth) break;
+            depth = eccentricity;
+            
+            int64_t next = queue.back();
+            for (size_t h = queue.size(); h-- > 0 && level[queue[h]] == eccentricity;) {
+                if (degree[queue[h]] < degree[next]) {
+                    next = queue[h];
+                }
+            }
+            root = next;
+        }
+        
+        // Cuthill-McKee numbering of the component
+        size_t head = order.size();
+        order.push_back(root);
+        numbered[root] = 1;
+        while (head < order.size()) {
+            const int64_t u = order[head++];
+            neighbors.clear();
+            for (int64_t k = rowstr[u]; k < rowstr[u+1]; k++) {
+                const int64_t v = colidx[k];
+                if (!numbered[v]) {
+                    numbered[v] = 1;
+                    neighbors.push_back(v);
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end(), [&](int64_t v1, int64_t v2) {
+                return degree[v1] != degree[v2] ? degree[v1] < degree[v2] : v1 < v2;
+            });
+            order.insert(order.end(), neighbors.begin(), neighbors.end());
+        }
+    }
+    
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::reorder() {
+    const int64_t n = params_.na;
+    const auto perm = reverse_cuthill_mckee(rowstr_, colidx_, n);
+    
+    std::vector<int64_t> inverse(n);
+    for (int64_t i = 0; i < n; i++) {
+        inverse[perm[i]] = i;
+    }
+    
+    std::vector<Index> rowstr(n + 1);
+    rowstr[0] = 0;
+    for (int64_t i = 0; i < n; i++) {
+        rowstr[i+1] = rowstr[i] + (rowstr_[perm[i]+1] - rowstr_[perm[i]]);
+    }
+    
+    std::vector<Index> colidx(colidx_.size());
+    std::vector<double> a(a_.size());
+    
+    // Symmetric permutation B = P A P^T, keeping columns sorted within rows
+    #pragma omp parallel num_threads(std::max(params_.num_threads, 1))
+    {
+        std::vector<std::pair<Index, double>> row;
+        
+        #pragma omp for schedule(dynamic, 256)
+        for (int64_t i = 0; i < n; i++) {
+            const int64_t old = perm[i];
+            row.clear();
+            for (int64_t k = rowstr_[old]; k < rowstr_[old+1]; k++) {
+                row.emplace_back(static_cast<Index>(inverse[colidx_[k]]), a_[k]);
+            }
+            std::sort(row.begin(), row.end(), [](const auto& e1, const auto& e2) {
+                return e1.first < e2.first;
+            });
+            
+            for (size_t k = 0; k < row.size(); k++) {
+                colidx[rowstr[i] + k] = row[k].first;
+                a[rowstr[i] + k] = row[k].second;
+            }
+        }
+    }
+    
+    rowstr_ = std::move(rowstr);
+    colidx_ = std::move(colidx);
+    a_ = std::move(a);
+    
+    // The vectors need no permutation: run_benchmark restarts from x = 1,
+    // which any symmetric permutation leaves unchanged, and zeta depends
+    // only on dot products
+    diagonal_.clear();
+    prepare_spmv();
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::set_shift(const double shift) {
+    const int nthreads = std::max(params_.num_threads, 1);
+    
+    if (diagonal_.empty()) {
+        diagonal_.assign(params_.na, -1);
+        
+        #pragma omp parallel for num_threads(nthreads)
+        for (int64_t i = 0; i < params_.na; i++) {
+            for (int64_t k = rowstr_[i]; k < rowstr_[i+1]; k++) {
+                if (colidx_[k] == i) {
+                    diagonal_[i] = k;
+                }
+            }
+        }
+        
+        if (std::find(diagonal_.begin(), diagonal_.end(), -1) != diagonal_.end()) {
+            diagonal_.clear();
+            throw std::runtime_error("a row has no stored diagonal entry to shift");
+        }
+    }
+    
+    // The assembly adds rcond - shift to each diagonal, so moving to a new
+    // shift only changes that term
+    const double delta = params_.shift - shift;
+    
+    #pragma omp parallel for num_threads(nthreads)
+    for (int64_t i = 0; i < params_.na; i++) {
+        a_[diagonal_[i]] += delta;
+    }
+    
+    params_.shift = shift;
+    prepare_spmv();
+}
+
+template <std::signed_integral Index>
+int64_t SparseMatrix<Index>::bandwidth() const noexcept {
+    int64_t width = 0;
+    
+    #pragma omp parallel for reduction(max:width) num_threads(std::max(params_.num_threads, 1))
+    for (int64_t i = 0; i < params_.na; i++) {
+        for (int64_t k = rowstr_[i]; k < rowstr_[i+1]; k++) {
+            width = std::max(width, std::abs(i - static_cast<int64_t>(colidx_[k])));
+        }
+    }
+    
+    return width;
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::make_matrix() {
     constexpr int64_t firstrow = 0;
     const int64_t lastrow = params_.na - 1;
     constexpr int64_t firstcol = 0;
     const int64_t lastcol = params_.na - 1;
     
-    std::vector<int64_t> arow(params_.na);
-    std::vector<std::vector<int64_t>> acol(params_.na, std::vector<int64_t>(params_.nonzer + 1));
-    std::vector<std::vector<double>> aelt(params_.na, std::vector<double>(params_.nonzer + 1));
-    std::vector<int64_t> iv(params_.na);
+    StagingArena arena(params_.na, params_.nonzer + 1);
     
     [[maybe_unused]] const double zeta_local = randlc(&tran, amult);
     
@@ -260,29 +1912,31 @@ void SparseMatrix::make_matrix() {
         nn1 *= 2;
     }
     
-    for (int64_t iouter = 0; iouter < params_.na; iouter++) {
-        int64_t nzv = params_.nonzer;
-        
+    if (params_.parallel_generation) {
+        generate_rows_parallel(arena, nn1);
+    } else {
         std::vector<double> vc(params_.nonzer + 1);
         std::vector<int64_t> ivc(params_.nonzer + 1);
         
-        generate_sparse_vector(params_.na, nzv, nn1, vc, ivc);
-        vector_set(params_.na, vc, ivc, &nzv, iouter + 1, 0.5);
-        
-        arow[iouter] = nzv;
-        for (int64_t ivelt = 0; ivelt < nzv; ivelt++) {
-            acol[iouter][ivelt] = ivc[ivelt] - 1;
-            aelt[iouter][ivelt] = vc[ivelt];
+        for (int64_t iouter = 0; iouter < params_.na; iouter++) {
+            int64_t nzv = params_.nonzer;
+            
+            generate_sparse_vector(params_.na, nzv, nn1, vc, ivc);
+            vector_set(params_.na, vc, ivc, &nzv, iouter + 1, 0.5);
+            
+            arena.arow[iouter] = nzv;
+            for (int64_t ivelt = 0; ivelt < nzv; ivelt++) {
+                arena.cols(iouter)[ivelt] = ivc[ivelt] - 1;
+                arena.elts(iouter)[ivelt] = vc[ivelt];
+            }
         }
     }
     
-    std::vector<int64_t> nzloc(params_.na);
     sparse_matrix_assembly(
         a_, colidx_, rowstr_,
-        params_.na, nz, params_.nonzer,
-        arow, acol, aelt,
+        params_.na, params_.nonzer,
+        arena,
         firstrow, lastrow,
-        nzloc,
         params_.rcond, params_.shift
     );
     
@@ -291,63 +1945,213 @@ void SparseMatrix::make_matrix() {
         const auto row_start = rowstr_[j];
         const auto row_end = rowstr_[j+1];
         for (int64_t k = row_start; k < row_end; k++) {
-            colidx_[k] -= firstcol;
+            colidx_[k] -= static_cast<Index>(firstcol);
         }
     }
 }
 
-void SparseMatrix::sparse_matrix_assembly(
-    std::vector<double>& a, 
-    std::vector<int64_t>& colidx, 
-    std::vector<int64_t>& rowstr,
-    const int64_t n, const int64_t nz, [[maybe_unused]] const int64_t nozer,
-    const std::vector<int64_t>& arow,
-    const std::vector<std::vector<int64_t>>& acol,
-    const std::vector<std::vector<double>>& aelt,
-    const int64_t firstrow, const int64_t lastrow,
-    std::vector<int64_t>& nzloc,
-    const double rcond, const double shift
-) {
-    const int64_t nrows = lastrow - firstrow + 1;
+// Largest number of outer products touching a single row; sizes the
+// per-thread scratch so the assembly loops never reallocate
+static int64_t max_row_contributions(const std::vector<int64_t>& contrib_ptr) noexcept {
+    int64_t max_count = 0;
+    for (size_t j = 1; j < contrib_ptr.size(); j++) {
+        max_count = std::max(max_count, contrib_ptr[j] - contrib_ptr[j-1]);
+    }
+    return max_count;
+}
+
+// Transposed outer-product pattern: for each row j, the arena entries (i, nza)
+// whose column is j, in increasing i. Entries are encoded as i * width + nza.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::build_row_contributions(
+    std::vector<int64_t>& contrib_ptr,
+    std::vector<int64_t>& contrib,
+    const int64_t n,
+    const StagingArena& arena,
+    const int64_t nrows
+) const {
+    const int64_t width = arena.width;
     
-    std::fill_n(rowstr.begin(), nrows + 1, 0);
+    contrib_ptr.assign(nrows + 1, 0);
+    for (int64_t i = 0; i < n; i++) {
+        for (int64_t nza = 0; nza < arena.arow[i]; nza++) {
+            contrib_ptr[arena.cols(i)[nza] + 1]++;
+        }
+    }
+    for (int64_t j = 1; j < nrows + 1; j++) {
+        contrib_ptr[j] += contrib_ptr[j-1];
+    }
     
+    contrib.resize(contrib_ptr[nrows]);
+    std::vector<int64_t> fill(contrib_ptr.begin(), contrib_ptr.end() - 1);
     for (int64_t i = 0; i < n; i++) {
-        for (int64_t nza = 0; nza < arow[i]; nza++) {
-            const int64_t j = acol[i][nza] + 1;
-            rowstr[j] += arow[i];
+        for (int64_t nza = 0; nza < arena.arow[i]; nza++) {
+            contrib[fill[arena.cols(i)[nza]]++] = i * width + nza;
         }
     }
+}
+
+// Exact row lengths for the assembled matrix. Row j receives the pattern of
+// every outer product i that has a nonzero in column j, so its length is the
+// size of the union of those patterns. Returns the total nonzero count.
+template <std::signed_integral Index>
+int64_t SparseMatrix<Index>::count_row_nonzeros(
+    std::vector<Index>& rowstr,
+    const std::vector<int64_t>& contrib_ptr,
+    const std::vector<int64_t>& contrib,
+    const StagingArena& arena,
+    const int64_t nrows
+) const {
+    const int64_t width = arena.width;
+    const int64_t max_entries = max_row_contributions(contrib_ptr) * width;
     
     rowstr[0] = 0;
+    
+    #pragma omp parallel num_threads(std::max(params_.num_threads, 1))
+    {
+        std::vector<int64_t> cols;
+        cols.reserve(max_entries);
+        
+        #pragma omp for schedule(dynamic, 256)
+        for (int64_t j = 0; j < nrows; j++) {
+            cols.clear();
+            for (int64_t c = contrib_ptr[j]; c < contrib_ptr[j+1]; c++) {
+                const int64_t i = contrib[c] / width;
+                cols.insert(cols.end(), arena.cols(i), arena.cols(i) + arena.arow[i]);
+            }
+            std::sort(cols.begin(), cols.end());
+            rowstr[j+1] = static_cast<Index>(std::unique(cols.begin(), cols.end()) - cols.begin());
+        }
+    }
+    
     for (int64_t j = 1; j < nrows + 1; j++) {
         rowstr[j] += rowstr[j-1];
     }
-    const int64_t nza_final = rowstr[nrows] - 1;
     
-    if (nza_final > nz) {
-        throw std::runtime_error("Space for matrix elements exceeded in sparse assembly");
+    return rowstr[nrows];
+}
+
+// Sort-and-reduce assembly. Each row gathers its (col, val) triplets from the
+// transposed pattern, sorts them by column and merges duplicates. Ties keep
+// outer-product order, so every sum is formed in the same order as the
+// insertion assembly and the result is bit-identical to it.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::assemble_sorted(
+    std::vector<double>& a,
+    std::vector<Index>& colidx,
+    const std::vector<Index>& rowstr,
+    const std::vector<int64_t>& contrib_ptr,
+    const std::vector<int64_t>& contrib,
+    const int64_t n,
+    const StagingArena& arena,
+    const int64_t nrows,
+    const double rcond, const double shift
+) const {
+    struct Triplet {
+        int64_t col;
+        int64_t seq;
+        double val;
+    };
+    
+    const int64_t width = arena.width;
+    const int64_t max_entries = max_row_contributions(contrib_ptr) * width;
+    
+    // The per-product scale is a running product in the reference code;
+    // tabulate it serially to keep the exact same rounding
+    std::vector<double> sizes(n);
+    const double ratio = std::pow(rcond, 1.0 / static_cast<double>(n));
+    double size = 1.0;
+    for (int64_t i = 0; i < n; i++) {
+        sizes[i] = size;
+        size *= ratio;
+    }
+    
+    #pragma omp parallel num_threads(std::max(params_.num_threads, 1))
+    {
+        std::vector<Triplet> triplets;
+        triplets.reserve(max_entries);
+        
+        #pragma omp for schedule(dynamic, 256)
+        for (int64_t j = 0; j < nrows; j++) {
+            triplets.clear();
+            
+            for (int64_t c = contrib_ptr[j]; c < contrib_ptr[j+1]; c++) {
+                const int64_t i = contrib[c] / width;
+                const int64_t nza = contrib[c] % width;
+                const double scale = sizes[i] * arena.elts(i)[nza];
+                
+                for (int64_t nzrow = 0; nzrow < arena.arow[i]; nzrow++) {
+                    const int64_t jcol = arena.cols(i)[nzrow];
+                    double va = arena.elts(i)[nzrow] * scale;
+                    
+                    if (jcol == j && j == i) {
+                        va += rcond - shift;
+                    }
+                    
+                    triplets.push_back({jcol, static_cast<int64_t>(triplets.size()), va});
+                }
+            }
+            
+            std::sort(triplets.begin(), triplets.end(), [](const Triplet& x, const Triplet& y) {
+                return x.col != y.col ? x.col < y.col : x.seq < y.seq;
+            });
+            
+            int64_t k = rowstr[j] - 1;
+            int64_t last_col = -1;
+            for (const auto& t : triplets) {
+                if (t.col != last_col) {
+                    k++;
+                    colidx[k] = static_cast<Index>(t.col);
+                    a[k] = 0.0;
+                    last_col = t.col;
+                }
+                a[k] += t.val;
+            }
+        }
     }
+}
+
+template <std::signed_integral Index>
+void SparseMatrix<Index>::sparse_matrix_assembly(
+    std::vector<double>& a, 
+    std::vector<Index>& colidx, 
+    std::vector<Index>& rowstr,
+    const int64_t n, [[maybe_unused]] const int64_t nozer,
+    const StagingArena& arena,
+    const int64_t firstrow, const int64_t lastrow,
+    const double rcond, const double shift
+) {
+    const int64_t nrows = lastrow - firstrow + 1;
+    
+    std::vector<int64_t> contrib_ptr;
+    std::vector<int64_t> contrib;
+    build_row_contributions(contrib_ptr, contrib, n, arena, nrows);
+    
+    // Size the arrays exactly, so every row fills up with no slack left to
+    // compact away afterwards
+    const int64_t nnz = count_row_nonzeros(rowstr, contrib_ptr, contrib, arena, nrows);
+    a.assign(nnz, 0.0);
+    colidx.assign(nnz, -1);
     
-    for (int64_t j = 0; j < nrows; j++) {
-        const auto row_start = rowstr[j];
-        const auto row_end = rowstr[j+1];
-        std::fill(a.begin() + row_start, a.begin() + row_end, 0.0);
-        std::fill(colidx.begin() + row_start, colidx.begin() + row_end, -1);
-        nzloc[j] = 0;
+    if (params_.assembly == AssemblyMethod::sorted) {
+        assemble_sorted(
+            a, colidx, rowstr, contrib_ptr, contrib,
+            n, arena, nrows, rcond, shift
+        );
+        return;
     }
     
     double size = 1.0;
     const double ratio = std::pow(rcond, 1.0 / static_cast<double>(n));
     
     for (int64_t i = 0; i < n; i++) {
-        for (int64_t nza = 0; nza < arow[i]; nza++) {
-            const int64_t j = acol[i][nza];
-            const double scale = size * aelt[i][nza];
+        for (int64_t nza = 0; nza < arena.arow[i]; nza++) {
+            const int64_t j = arena.cols(i)[nza];
+            const double scale = size * arena.elts(i)[nza];
             
-            for (int64_t nzrow = 0; nzrow < arow[i]; nzrow++) {
-                const int64_t jcol = acol[i][nzrow];
-                double va = aelt[i][nzrow] * scale;
+            for (int64_t nzrow = 0; nzrow < arena.arow[i]; nzrow++) {
+                const int64_t jcol = arena.cols(i)[nzrow];
+                double va = arena.elts(i)[nzrow] * scale;
                 
                 if (jcol == j && j == i) {
                     va += rcond - shift;
@@ -364,16 +2168,15 @@ void SparseMatrix::sparse_matrix_assembly(
                                 colidx[kk+1] = colidx[kk];
                             }
                         }
-                        colidx[k] = jcol;
+                        colidx[k] = static_cast<Index>(jcol);
                         a[k] = 0.0;
                         inserted = true;
                         break;
                     } else if (colidx[k] == -1) {
-                        colidx[k] = jcol;
+                        colidx[k] = static_cast<Index>(jcol);
                         inserted = true;
                         break;
                     } else if (colidx[k] == jcol) {
-                        nzloc[j]++;
                         inserted = true;
                         break;
                     }
@@ -388,29 +2191,83 @@ void SparseMatrix::sparse_matrix_assembly(
         }
         size *= ratio;
     }
+}
+
+// Rows consume a data-dependent number of random pairs (out-of-range and
+// duplicate locations are rejected), so a row's stream offset is unknown until
+// the previous row is done. The expensive part, drawing the pairs, is therefore
+// done in parallel over fixed windows of the stream: each thread jumps the LCG
+// to the start of its slice of the window. A cheap serial scan then hands the
+// pairs to rows exactly as generate_sparse_vector would, so the matrix is
+// bit-identical to the serial path.
+template <std::signed_integral Index>
+void SparseMatrix<Index>::generate_rows_parallel(
+    StagingArena& arena,
+    const int64_t nn1
+) {
+    constexpr int64_t pairs_per_thread = 1 << 15;
+    const int num_threads = std::max(params_.num_threads, 1);
+    const int64_t window = pairs_per_thread * num_threads;
     
-    for (int64_t j = 1; j < nrows; j++) {
-        nzloc[j] += nzloc[j-1];
-    }
+    std::vector<double> vecelt(window);
+    std::vector<int64_t> vecloc(window);
+    std::vector<double> vc(params_.nonzer + 1);
+    std::vector<int64_t> ivc(params_.nonzer + 1);
+    
+    double seed = tran;
+    int64_t iouter = 0;
+    int64_t nzv = 0;
     
-    for (int64_t j = 0; j < nrows; j++) {
-        const int64_t j1 = (j > 0) ? rowstr[j] - nzloc[j-1] : 0;
-        const int64_t j2 = rowstr[j+1] - nzloc[j];
-        int64_t nza = rowstr[j];
+    while (iouter < params_.na) {
+        #pragma omp parallel num_threads(num_threads)
+        {
+            #ifdef _OPENMP
+            const int tid = omp_get_thread_num();
+            #else
+            const int tid = 0;
+            #endif
+            const int64_t begin = tid * pairs_per_thread;
+            double s = jump_ahead(seed, amult, 2 * begin);
+            
+            for (int64_t k = begin; k < begin + pairs_per_thread; k++) {
+                vecelt[k] = randlc(&s, amult);
+                vecloc[k] = convert_real_to_int(randlc(&s, amult), nn1) + 1;
+            }
+        }
         
-        for (int64_t k = j1; k < j2; k++) {
-            a[k] = a[nza];
-            colidx[k] = colidx[nza];
-            nza++;
+        int64_t k = 0;
+        for (; k < window && iouter < params_.na; k++) {
+            const int64_t i = vecloc[k];
+            
+            if (i > params_.na) continue;
+            if (std::find(ivc.begin(), ivc.begin() + nzv, i) != ivc.begin() + nzv) continue;
+            
+            vc[nzv] = vecelt[k];
+            ivc[nzv] = i;
+            nzv++;
+            
+            if (nzv == params_.nonzer) {
+                vector_set(params_.na, vc, ivc, &nzv, iouter + 1, 0.5);
+                
+                arena.arow[iouter] = nzv;
+                for (int64_t ivelt = 0; ivelt < nzv; ivelt++) {
+                    arena.cols(iouter)[ivelt] = ivc[ivelt] - 1;
+                    arena.elts(iouter)[ivelt] = vc[ivelt];
+                }
+                
+                iouter++;
+                nzv = 0;
+            }
         }
+        
+        seed = jump_ahead(seed, amult, 2 * k);
     }
     
-    for (int64_t j = 1; j < nrows + 1; j++) {
-        rowstr[j] -= nzloc[j-1];
-    }
+    tran = seed;
 }
 
-void SparseMatrix::generate_sparse_vector(
+template <std::signed_integral Index>
+void SparseMatrix<Index>::generate_sparse_vector(
     const int64_t n, const int64_t nz, const int64_t nn1,
     std::vector<double>& v, 
     std::vector<int64_t>& iv
@@ -437,7 +2294,8 @@ void SparseMatrix::generate_sparse_vector(
     }
 }
 
-void SparseMatrix::vector_set(
+template <std::signed_integral Index>
+void SparseMatrix<Index>::vector_set(
     [[maybe_unused]] const int64_t n, 
     std::vector<double>& v, 
     std::vector<int64_t>& iv, 
@@ -457,7 +2315,8 @@ void SparseMatrix::vector_set(
     }
 }
 
-double SparseMatrix::get_zeta_verify_value() const noexcept {
+template <std::signed_integral Index>
+double SparseMatrix<Index>::get_zeta_verify_value() const noexcept {
     switch (params_.problem_class) {
         case 'S': return 8.5971775078648;
         case 'W': return 10.362595087124;
@@ -470,18 +2329,41 @@ double SparseMatrix::get_zeta_verify_value() const noexcept {
     }
 }
 
-double SparseMatrix::get_mflops(const double execution_time) const noexcept {
+template <std::signed_integral Index>
+double SparseMatrix<Index>::get_mflops(const double execution_time) const noexcept {
     if (execution_time == 0.0) {
         return 0.0;
     }
     
-    return (2.0 * params_.max_iter * params_.na) *
+    if (params_.problem_class == 'U') {
+        // Per outer iteration: 25 CG steps of one SpMV and five vector
+        // operations, the residual SpMV and the normalization
+        const double nnz = static_cast<double>(rowstr_[params_.na]);
+        const double na = static_cast<double>(params_.na);
+        const double ops = 25.0 * (2.0 * nnz + 10.0 * na) + (2.0 * nnz + 3.0 * na) + 5.0 * na;
+        return params_.max_iter * params_.block * ops / execution_time / 1000000.0;
+    }
+    
+    return (2.0 * params_.max_iter * params_.na * params_.block) *
            (3.0 + (params_.nonzer * (params_.nonzer + 1)) +
             25.0 * (5.0 + (params_.nonzer * (params_.nonzer + 1))) + 3.0) /
            execution_time / 1000000.0;
 }
 
-bool SparseMatrix::verify() const noexcept {
+template <std::signed_integral Index>
+double SparseMatrix<Index>::get_benchmark_bytes() const noexcept {
+    // Per conjugate_gradient: the 5-vector setup, r.r, 25 steps of a 2-vector
+    // dot and 6- and 3-vector updates, the 2-vector residual norm; then 4 in
+    // compute_norms_and_normalize
+    constexpr double spmvs = 26.0;
+    constexpr double vector_sweeps = 5.0 + 1.0 + 25.0 * (2.0 + 6.0 + 3.0) + 2.0 + 4.0;
+    
+    const double vector_bytes = sizeof(double) * static_cast<double>(params_.na);
+    return params_.max_iter * (spmvs * spmv_traffic().bytes + vector_sweeps * vector_bytes);
+}
+
+template <std::signed_integral Index>
+bool SparseMatrix<Index>::verify() const noexcept {
     constexpr double epsilon = 1.0e-10;
     
     if (params_.problem_class == 'U') {
@@ -494,4 +2376,7 @@ bool SparseMatrix::verify() const noexcept {
     return (err <= epsilon);
 }
 
-} // namespace npb::cg
\ No newline at end of file
+} // namespace npb::cg
+
+template class npb::cg::SparseMatrix<int32_t>;
+template class npb::cg::SparseMatrix<int64_t>;
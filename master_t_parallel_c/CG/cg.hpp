@@ -1,7 +1,16 @@
 #pragma once
 
 #include "utils.hpp" 
+#include "perf_counters.hpp"
+#include "profiler.hpp"
+#include "binned.hpp"
+#include "matrix_powers.hpp"
+#include "preconditioner.hpp"
+#include "sell.hpp"
+#include "symmetric.hpp"
+#include "tiled.hpp"
 
+#include <array>
 #include <vector>
 #include <span>
 #include <cstdint>
@@ -17,12 +26,48 @@
 #include <algorithm>
 #include <numeric>
 #include <functional>
+#include <concepts>
+#include <limits>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
 namespace npb::cg {
 
+enum class AssemblyMethod {
+    insertion,   // reference per-element insertion into each row
+    sorted       // per-row sort-and-reduce of outer-product triplets
+};
+
+enum class CgMethod {
+    classic,    // reference CG, several reductions per iteration
+    pipelined,  // Ghysels-Vanroose pipelined CG, one reduction per iteration
+    sstep       // s-step CG, one Gram reduction per s iterations
+};
+
+// Polynomial basis of the s-step CG Krylov blocks
+enum class SstepBasis {
+    monomial,   // powers of A scaled by a bound on its spectral radius
+    chebyshev   // Chebyshev polynomials on the Gershgorin interval of A
+};
+
+// Storage of the matrix values multiplied by the inner CG
+enum class Precision {
+    fp64,   // reference: double values throughout
+    fp32,   // float values, double accumulation, double refinement
+    bf16    // bfloat16 values, double accumulation, double refinement
+};
+
+enum class SpmvKernel {
+    csr,   // row-parallel compressed sparse row loop
+    sell,  // SELL-C-sigma chunks built from the CSR matrix
+    merge,      // merge-path split of rows plus nonzeros over the threads
+    symmetric,  // upper triangle only, transposed terms via per-thread buffers
+    binned,     // rows grouped by length class, one unrolled kernel per class
+    prefetch,   // CSR loop prefetching the input gathers a tuned distance ahead
+    tiled       // columns split into cache-sized tiles, one CSR segment per tile
+};
+
 struct Problem {
     int64_t na;          // size of matrix A
     int64_t nonzer;      // number of nonzeros per row
@@ -31,30 +76,198 @@ struct Problem {
     int64_t max_iter;    // maximum iterations
     char problem_class;  // problem class S, W, A, B, C, D, E, or U
     int num_threads;     // number of threads to use
+    bool parallel_generation{false}; // generate matrix rows with all threads
+    AssemblyMethod assembly{AssemblyMethod::insertion};
+    SpmvKernel spmv{SpmvKernel::csr};
+    Precision precision{Precision::fp64};
+    int64_t sell_sigma{256};         // SELL sorting window in rows
+    int64_t prefetch_distance{0};    // prefetch kernel lookahead in nonzeros, 0 to calibrate
+    int64_t spmv_tile{0};            // tiled kernel columns per tile, 0 to size from the cache
+    SellIsa sell_isa{best_sell_isa()};
+    bool reorder{false};             // apply reverse Cuthill-McKee before the benchmark
+    CgMethod cg{CgMethod::classic};
+    int64_t block{1};                // right-hand sides solved together (block mode if > 1)
+    int64_t sstep{4};                // iterations per block of the s-step CG
+    SstepBasis sstep_basis{SstepBasis::chebyshev};
+    PreconditionerKind preconditioner{PreconditionerKind::none};
+    double tolerance{0.0};           // stop a solve at ||r|| <= tolerance ||x||, 0 to run all iterations
+    int64_t cg_iterations{25};       // iterations per solve of the preconditioned CG, the cap with a tolerance
+    std::vector<double> shift_sweep; // further shifts to benchmark on the same assembled matrix
+    std::string matrix_file;         // Matrix Market input, empty for the NPB matrix
+    std::string matrix_cache;        // CSR cache directory, empty to disable
+    bool cache_populate{false};      // prefault the cache mapping and ask for huge pages
+    bool phase_timers{false};        // time the SpMV, dot and axpy phases of classic CG
+    bool profile{false};             // print the per-thread region profile
+    bool counters{false};            // count hardware events per thread
+};
+
+// Outer-product patterns produced by make_matrix: one row of width
+// nonzer + 1 per outer product, held in a single contiguous arena
+struct StagingArena {
+    int64_t width;
+    std::vector<int64_t> arow;    // entries used in each row
+    std::vector<int64_t> acol;    // column indices, rows x width
+    std::vector<double> aelt;     // values, rows x width
+    
+    StagingArena(int64_t rows, int64_t row_width)
+        : width(row_width), arow(rows), acol(rows * row_width), aelt(rows * row_width) {}
+    
+    [[nodiscard]] int64_t* cols(int64_t i) noexcept { return acol.data() + i * width; }
+    [[nodiscard]] const int64_t* cols(int64_t i) const noexcept { return acol.data() + i * width; }
+    [[nodiscard]] double* elts(int64_t i) noexcept { return aelt.data() + i * width; }
+    [[nodiscard]] const double* elts(int64_t i) const noexcept { return aelt.data() + i * width; }
+};
+
+// Assembled CSR arrays, as produced by make_matrix or read from a cache
+template <std::signed_integral Index>
+struct CsrMatrix {
+    std::vector<Index> rowstr;    // na + 1 row pointers
+    std::vector<Index> colidx;    // column indices, sorted within rows
+    std::vector<double> a;        // values
+};
+
+// Modeled memory traffic and floating-point work of a CG phase
+struct PhaseTraffic {
+    double bytes{0.0};
+    double flops{0.0};
 };
 
+// Iterative refinement of the mixed-precision CG over the timed outer
+// iterations. Matrix bytes are modeled like the CSR SpMV traffic.
+struct RefinementStats {
+    int64_t solves{0};              // conjugate_gradient calls
+    int64_t refinements{0};         // double residual corrections, all solves
+    int64_t max_refinements{0};     // most corrections in one solve
+    int64_t inner_iterations{0};    // low-precision CG iterations, all solves
+    double spmv_bytes{0.0};         // SpMV traffic of the mixed solves
+    double reference_bytes{0.0};    // the same solves with 26 double SpMVs each
+};
+
+// s-step CG over the timed outer iterations
+struct SstepStats {
+    int64_t solves{0};              // conjugate_gradient calls
+    int64_t blocks{0};              // Gram reductions, all solves
+    int64_t short_blocks{0};        // blocks ended early at the rounding floor of the Gram matrix
+    int64_t iterations{0};          // CG iterations, all solves
+    double max_gap{0.0};            // largest ||r - (x - A z)|| / ||x|| at a block boundary
+    double max_residual{0.0};       // largest ||x - A z|| / ||x|| at the end of a solve
+};
+
+// Preconditioned CG over the timed outer iterations
+struct PreconditionStats {
+    int64_t solves{0};              // conjugate_gradient calls
+    int64_t iterations{0};          // CG iterations, all solves
+    int64_t max_iterations{0};      // most iterations in one solve
+    int64_t converged{0};           // solves that reached the tolerance
+    double seconds{0.0};            // wall time of the solves on the master thread
+    double setup_seconds{0.0};      // building the preconditioner
+};
+
+// Index is the type of colidx_ and rowstr_. A 32-bit index halves the index
+// bytes streamed by the SpMV; use index_fits to check it can hold the matrix.
+template <std::signed_integral Index = int64_t>
 class SparseMatrix {
 public:
     // Constructors
     explicit SparseMatrix(const Problem& params);
     
-    // Run the benchmark
-    double run_benchmark(npb::utils::TimerManager& timer);
+    // Adopt an already assembled matrix instead of generating it
+    SparseMatrix(const Problem& params, CsrMatrix<Index> csr);
+    
+    // Whether Index can address a matrix for these parameters. Uses the
+    // na*(nonzer+1)^2 bound on the assembled nonzero count.
+    [[nodiscard]] static constexpr bool index_fits(const Problem& params) noexcept {
+        const int64_t nz_bound = params.na * (params.nonzer + 1) * (params.nonzer + 1);
+        return nz_bound <= std::numeric_limits<Index>::max();
+    }
+    
+    // Run the benchmark. profiler is reset and gets the per-thread regions
+    // benchmark, benchmark/conj_grad (with spmv, dot and axpy below it for
+    // the classic CG) and benchmark/norms. counters is reset and, if
+    // enabled, counts each thread's events over the benchmark region.
+    double run_benchmark(
+        npb::utils::TimerManager& timer,
+        npb::utils::RegionProfiler& profiler,
+        npb::utils::PerfCounters& counters
+    );
+    
+    // Residual gap and block count of the s-step CG
+    [[nodiscard]] const SstepStats& get_sstep_stats() const noexcept { return sstep_stats_; }
+    
+    // Iterations and time to tolerance of the preconditioned CG
+    [[nodiscard]] const PreconditionStats& get_precondition_stats() const noexcept { return precondition_stats_; }
+    
+    // Preconditioner of the preconditioned CG, built by run_benchmark
+    [[nodiscard]] const Preconditioner<Index>& preconditioner() const noexcept { return preconditioner_; }
+    
+    // Tile plan of the s-step matrix-powers kernel, set by run_benchmark
+    [[nodiscard]] const MatrixPowers<Index>& matrix_powers() const noexcept { return matrix_powers_; }
     
     // Get verification value
     [[nodiscard]] double get_zeta() const noexcept { return zeta_; }
     
+    // ||x - A z|| of the last outer iteration
+    [[nodiscard]] double get_rnorm() const noexcept { return rnorm_; }
+    
+    // Final zeta of every right-hand side in block mode
+    [[nodiscard]] const std::vector<double>& get_block_zeta() const noexcept { return block_zeta_; }
+    
     // Get verification value based on problem class
     [[nodiscard]] double get_zeta_verify_value() const noexcept;
     
     // Get problem details
     [[nodiscard]] const Problem& get_problem() const noexcept { return params_; }
     
-    // Get MFLOPS
+    // Assembled CSR arrays
+    [[nodiscard]] std::span<const Index> rowstr() const noexcept { return rowstr_; }
+    [[nodiscard]] std::span<const Index> colidx() const noexcept { return colidx_; }
+    [[nodiscard]] std::span<const double> values() const noexcept { return a_; }
+    
+    // Get MFLOPS, summed over all right-hand sides in block mode. Class U
+    // counts the operations from the stored nonzeros.
     [[nodiscard]] double get_mflops(double execution_time) const noexcept;
     
+    // Modeled memory traffic of the benchmark with the classic CG, counted
+    // over the same max_iter outer iterations as get_mflops: 26 SpMVs (see
+    // spmv_traffic) and 287 vector sweeps of na doubles per iteration
+    [[nodiscard]] double get_benchmark_bytes() const noexcept;
+    
     // Verification
     [[nodiscard]] bool verify() const noexcept;
+    
+    // Renumber rows and columns in reverse Cuthill-McKee order to shrink the
+    // matrix bandwidth, then rebuild the derived SpMV formats
+    void reorder();
+    
+    // Move the diagonal from the current shift to shift in place, as if
+    // the matrix had been assembled with it, and rebuild the derived SpMV
+    // formats. Throws std::runtime_error if a row stores no diagonal entry.
+    void set_shift(double shift);
+    
+    // Largest |i - j| over the stored entries
+    [[nodiscard]] int64_t bandwidth() const noexcept;
+    
+    // Nonzeros each of nthreads threads multiplies per SpMV with the given
+    // kernel: row-static blocks for CSR, equal merge-path diagonals for merge
+    [[nodiscard]] std::vector<int64_t> thread_nonzeros(SpmvKernel kernel, int nthreads) const;
+    
+    // Human-readable name of the SpMV kernel in use
+    [[nodiscard]] std::string spmv_description() const;
+    
+    // Best SpMV time of the CSR loop (distance 0) and of the prefetch
+    // kernel at each distance tried by its calibration sweep
+    [[nodiscard]] const std::vector<std::pair<int64_t, double>>& prefetch_sweep() const noexcept {
+        return prefetch_sweep_;
+    }
+    
+    // Traffic of the phase timed by T_SPMV, T_DOT or T_AXPY, summed over the
+    // timed outer iterations. Zero unless phase_timers is set.
+    [[nodiscard]] const PhaseTraffic& get_phase_traffic(npb::utils::TimerManager::TimerID id) const noexcept {
+        return phase_traffic_[id - npb::utils::TimerManager::T_SPMV];
+    }
+    
+    // Refinement work of the timed iterations; all zero with fp64
+    [[nodiscard]] const RefinementStats& get_refinement_stats() const noexcept { return refinement_; }
 
 private:
     // Problem parameters
@@ -62,34 +275,143 @@ private:
     
     // Matrix data
     std::vector<double> a_;           // Matrix elements
-    std::vector<int64_t> colidx_;     // Column indices
-    std::vector<int64_t> rowstr_;     // Row pointers
+    std::vector<Index> colidx_;       // Column indices
+    std::vector<Index> rowstr_;       // Row pointers
+    
+    // Derived SpMV formats, rebuilt from the CSR arrays by prepare_spmv
+    SellMatrix<Index> sell_;
+    SymmetricMatrix<Index> symmetric_;
+    BinnedMatrix<Index> binned_;
+    TiledMatrix<Index> tiled_;
+    
+    // Position of each row's diagonal entry in a_, found by the first
+    // set_shift and cleared by reorder
+    std::vector<int64_t> diagonal_;
     
-    // Vectors
+    // Matrix values rounded for the mixed-precision inner CG; only the one
+    // matching params_.precision is filled. bf16 keeps the upper 16 bits of
+    // the float.
+    std::vector<float> a_fp32_;
+    std::vector<uint16_t> a_bf16_;
+    RefinementStats refinement_;
+    
+    // s-step CG: Krylov basis rows of 2s + 1 entries (see MatrixPowers),
+    // the recurrence of each basis level, and the tiles that compute them
+    std::vector<double> basis_;
+    std::vector<typename MatrixPowers<Index>::Step> sstep_steps_;
+    std::vector<double> sstep_change_;    // B with A V = V B, row-major, (2s + 1)^2
+    double sstep_norm_{0.0};              // Gershgorin bound on ||A||
+    MatrixPowers<Index> matrix_powers_;
+    SstepStats sstep_stats_;
+    
+    // Preconditioned CG: M^-1 r, and the preconditioner M
+    std::vector<double> y_;
+    Preconditioner<Index> preconditioner_;
+    PreconditionStats precondition_stats_;
+    
+    // Lookahead of the prefetch kernel and the sweep that chose it
+    int64_t prefetch_distance_{0};
+    double prefetch_speedup_{1.0};    // CSR time over prefetch time in the sweep
+    std::vector<std::pair<int64_t, double>> prefetch_sweep_;
+    
+    // Vectors; in block mode entry j of right-hand side v is at j * block + v
     std::vector<double> x_;           // Solution vector
     std::vector<double> z_;           // Temporary vector
     std::vector<double> p_;           // Conjugate direction
     std::vector<double> q_;           // Temporary vector
     std::vector<double> r_;           // Residual
     
+    // Pipelined CG vectors, allocated only for CgMethod::pipelined
+    std::vector<double> w_;           // A r, gathered by the SpMV
+    std::vector<double> w_next_;      // A r of the next iteration
+    std::vector<double> s_;           // A p
+    std::vector<double> t_;           // A s
+    
+    // Per-thread partial sums of the pipelined reduction, one set per
+    // iteration parity so a set is never rewritten while being read
+    struct alignas(64) PartialSums {
+        double gamma;
+        double delta;
+    };
+    std::vector<PartialSums> partials_;
+    
+    // Partial sum of the last, unfinished row of each thread in the
+    // merge-path SpMV, added to out after the barrier
+    struct alignas(64) MergeCarry {
+        int64_t row;
+        double value;
+    };
+    std::vector<MergeCarry> carries_;
+    
+    // Block mode: per-thread partial sums, one set per reduction parity,
+    // each thread's slot padded to whole cache lines
+    std::vector<double> block_partials_;
+    int64_t block_stride_{0};
+    
+    // Phase timing of the classic CG; set only for the timed iterations
+    npb::utils::TimerManager* phase_timer_{nullptr};
+    std::array<PhaseTraffic, 3> phase_traffic_{};
+    
+    // Profiler regions of run_benchmark. The classic CG phases are indexed
+    // like phase_traffic_ and recorded only while timed_ is set.
+    npb::utils::RegionProfiler* profiler_{nullptr};
+    int benchmark_region_{0};
+    int conj_grad_region_{0};
+    int norms_region_{0};
+    std::array<int, 3> phase_regions_{};
+    bool timed_{false};
+    npb::utils::PerfCounters* counters_{nullptr};
+    
     // Scalars for benchmark
     double zeta_{0.0};
+    double rnorm_{0.0};
+    std::vector<double> block_zeta_;
+    
+    // Size the work vectors for the problem, block width and CG method
+    void allocate_vectors();
     
     // Matrix generation helpers
     void make_matrix();
+    void build_row_contributions(
+        std::vector<int64_t>& contrib_ptr,
+        std::vector<int64_t>& contrib,
+        int64_t n,
+        const StagingArena& arena,
+        int64_t nrows
+    ) const;
+    int64_t count_row_nonzeros(
+        std::vector<Index>& rowstr,
+        const std::vector<int64_t>& contrib_ptr,
+        const std::vector<int64_t>& contrib,
+        const StagingArena& arena,
+        int64_t nrows
+    ) const;
+    void assemble_sorted(
+        std::vector<double>& a,
+        std::vector<Index>& colidx,
+        const std::vector<Index>& rowstr,
+        const std::vector<int64_t>& contrib_ptr,
+        const std::vector<int64_t>& contrib,
+        int64_t n,
+        const StagingArena& arena,
+        int64_t nrows,
+        double rcond, double shift
+    ) const;
     void sparse_matrix_assembly(
         std::vector<double>& a, 
-        std::vector<int64_t>& colidx, 
-        std::vector<int64_t>& rowstr,
-        int64_t n, int64_t nz, int64_t nozer,
-        const std::vector<int64_t>& arow,
-        const std::vector<std::vector<int64_t>>& acol,
-        const std::vector<std::vector<double>>& aelt,
+        std::vector<Index>& colidx, 
+        std::vector<Index>& rowstr,
+        int64_t n, int64_t nozer,
+        const StagingArena& arena,
         int64_t firstrow, int64_t lastrow,
-        std::vector<int64_t>& nzloc,
         double rcond, double shift
     );
     
+    void generate_rows_parallel(
+        StagingArena& arena,
+        int64_t nn1
+    );
+    
     void generate_sparse_vector(
         int64_t n, int64_t nz, int64_t nn1,
         std::vector<double>& v, 
@@ -105,10 +427,67 @@ private:
         double val
     ) noexcept;
     
+    // Build the format used by the selected SpMV kernel
+    void prepare_spmv();
+    
+    // out = A in. Orphaned worksharing: call from inside a parallel region.
+    // The CSR loop is nowait and only safe to follow with loops using the
+    // same static schedule over na rows; other kernels end with a barrier.
+    void spmv(const double* in, double* out) noexcept;
+    void spmv_csr(const double* in, double* out) noexcept;
+    void spmv_merge(const double* in, double* out) noexcept;
+    void spmv_prefetch(const double* in, double* out, int64_t distance) noexcept;
+    
+    // CSR loop over the rounded values of params_.precision, accumulating
+    // in double; nowait like spmv_csr
+    void spmv_low(const double* in, double* out) noexcept;
+    
+    // Basis recurrence from the Gershgorin interval of A and the
+    // matrix-powers tiles for nthreads threads
+    void prepare_sstep(int nthreads);
+    
+    // Time the CSR loop and the prefetch kernel at each candidate distance
+    // (only params_.prefetch_distance if set) and keep the fastest one. A
+    // calibrated distance of 0 means the CSR loop won and is used instead.
+    void calibrate_prefetch();
+    
+    // Bytes moved and flops of one SpMV with the selected kernel
+    [[nodiscard]] PhaseTraffic spmv_traffic() const noexcept;
+    
+    // Time a CG phase in the profiler on the calling thread. With
+    // phase_timer_ set, also bracket it with barriers and time it on the
+    // master thread, adding traffic to its total; all threads must then
+    // call them.
+    void phase_start(npb::utils::TimerManager::TimerID id) noexcept;
+    void phase_stop(npb::utils::TimerManager::TimerID id, const PhaseTraffic& traffic) noexcept;
+    
+    // Row and nonzero where a merge-path diagonal crosses the path
+    [[nodiscard]] std::pair<int64_t, int64_t> merge_path_search(int64_t diagonal) const noexcept;
+    
     // Core algorithm
     double conjugate_gradient() noexcept;
+    double conjugate_gradient_classic() noexcept;
+    double conjugate_gradient_pipelined() noexcept;
+    double conjugate_gradient_mixed() noexcept;
+    double conjugate_gradient_sstep() noexcept;
+    double conjugate_gradient_preconditioned() noexcept;
+    
+    // Block mode: k independent CG solves sharing one matrix pass per SpMV
+    double run_benchmark_block(npb::utils::TimerManager& timer);
+    void conjugate_gradient_block(std::vector<double>& rnorm, int& parity) noexcept;
+    void spmm(const double* in, double* out) noexcept;
+    
+    // Sum values over the team in thread order; every thread gets the
+    // result. Collective: all threads must call it.
+    void block_allreduce(std::vector<double>& values, int& parity) noexcept;
+    
+    // x = z / ||z||; returns x.z and 1 / ||z||. Orphaned worksharing.
+    std::pair<double, double> compute_norms_and_normalize() noexcept;
 };
 
+using SparseMatrix32 = SparseMatrix<int32_t>;
+using SparseMatrix64 = SparseMatrix<int64_t>;
+
 // Helper functions
 constexpr int64_t convert_real_to_int(double x, int64_t power2) noexcept;
 
@@ -1,4 +1,6 @@
 #include "cg.hpp"
+#include "matrix_cache.hpp"
+#include "matrix_market.hpp"
 #include "utils.hpp"
 
 #include <iostream>
@@ -8,8 +10,422 @@
 #include <chrono>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
+#include <concepts>
+#include <optional>
+#include <limits>
+#include <stdexcept>
+#include <numeric>
+#include <algorithm>
+
+namespace {
+
+const char* precondition_name(const npb::cg::PreconditionerKind kind) {
+    switch (kind) {
+    case npb::cg::PreconditionerKind::jacobi:
+        return "jacobi";
+    case npb::cg::PreconditionerKind::block_jacobi:
+        return "block-jacobi";
+    case npb::cg::PreconditionerKind::ilu0:
+        return "ilu0";
+    default:
+        return "none";
+    }
+}
+
+template <std::signed_integral Index>
+int run_cg(const npb::cg::Problem& params, const std::optional<npb::utils::Roofline>& roofline) {
+    // Enable timer for initialization
+    npb::utils::TimerManager timer;
+    timer.enable();
+    
+    // Load the assembled matrix from the cache, timed apart from T_INIT
+    std::filesystem::path cache_path;
+    std::optional<npb::cg::CsrMatrix<Index>> cached;
+    if (!params.matrix_cache.empty()) {
+        cache_path = npb::cg::matrix_cache_path(params.matrix_cache, params, sizeof(Index));
+        timer.start(npb::utils::TimerManager::T_CACHE);
+        cached = npb::cg::load_matrix_cache<Index>(cache_path, params, params.cache_populate);
+        timer.stop(npb::utils::TimerManager::T_CACHE);
+    }
+    const bool from_cache = cached.has_value();
+    
+    timer.start(npb::utils::TimerManager::T_INIT);
+    
+    std::optional<npb::cg::CsrMatrix<Index>> imported;
+    if (!params.matrix_file.empty()) {
+        try {
+            imported = npb::cg::read_matrix_market<Index>(params.matrix_file, params.num_threads);
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot read " << params.matrix_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    auto& assembled = from_cache ? cached : imported;
+    
+    // Create the sparse matrix
+    npb::cg::SparseMatrix<Index> matrix = assembled
+        ? npb::cg::SparseMatrix<Index>(params, std::move(*assembled))
+        : npb::cg::SparseMatrix<Index>(params);
+    
+    timer.stop(npb::utils::TimerManager::T_INIT);
+    if (from_cache) {
+        std::cout << " Cache load time = " << std::setw(15) << std::fixed << std::setprecision(3)
+                  << timer.read(npb::utils::TimerManager::T_CACHE) << " seconds ("
+                  << timer.read_ns(npb::utils::TimerManager::T_CACHE) << " ns)\n";
+    }
+std::cout << " Initialization time = " << std::setw(15) << std::fixed << std::setprecision(3) 
+          << timer.read(npb::utils::TimerManager::T_INIT) << " seconds ("
+          << timer.read_ns(npb::utils::TimerManager::T_INIT) << " ns)\n";
+    
+    if (!params.matrix_cache.empty() && !from_cache) {
+        if (npb::cg::save_matrix_cache<Index>(cache_path, params, matrix.rowstr(), matrix.colidx(), matrix.values())) {
+            std::cout << " Matrix cache:    wrote " << cache_path.string() << "\n";
+        } else {
+            std::cerr << " Matrix cache: cannot write " << cache_path << std::endl;
+        }
+    }
+    
+    if (params.reorder) {
+        const int64_t bandwidth_before = matrix.bandwidth();
+        timer.start(npb::utils::TimerManager::T_REORDER);
+        matrix.reorder();
+        timer.stop(npb::utils::TimerManager::T_REORDER);
+        std::cout << " Reordering time = " << std::setw(15) << std::fixed << std::setprecision(3)
+                  << timer.read(npb::utils::TimerManager::T_REORDER) << " seconds ("
+                  << timer.read_ns(npb::utils::TimerManager::T_REORDER) << " ns)\n";
+        std::cout << " Bandwidth:       " << bandwidth_before << " -> " << matrix.bandwidth() << " (RCM)\n";
+    }
+    std::cout << " SpMV kernel:     " << matrix.spmv_description() << "\n";
+    std::cout << " CG method:       ";
+    if (params.cg == npb::cg::CgMethod::sstep) {
+        std::cout << "s-step, s = " << params.sstep << ", "
+                  << (params.sstep_basis == npb::cg::SstepBasis::chebyshev ? "Chebyshev" : "monomial") << " basis\n";
+    } else {
+        std::cout << (params.cg == npb::cg::CgMethod::pipelined ? "pipelined" : "classic") << "\n";
+    }
+    
+    if (params.spmv == npb::cg::SpmvKernel::prefetch) {
+        // Best of the calibration SpMVs; distance 0 is the CSR loop
+        const auto& sweep = matrix.prefetch_sweep();
+        std::cout << "\n  distance    SpMV (ms)    speedup\n";
+        for (const auto& [distance, seconds] : sweep) {
+            std::cout << "  " << std::setw(8) << distance << std::setw(13) << std::fixed << std::setprecision(3)
+                      << seconds * 1.0e3 << std::setw(11) << std::setprecision(3)
+                      << sweep.front().second / seconds << "\n";
+        }
+    }
+    
+    if (params.spmv == npb::cg::SpmvKernel::merge) {
+        const auto static_nnz = matrix.thread_nonzeros(npb::cg::SpmvKernel::csr, params.num_threads);
+        const auto merge_nnz = matrix.thread_nonzeros(npb::cg::SpmvKernel::merge, params.num_threads);
+        
+        std::cout << "\n  thread    nnz (row-static)    nnz (merge-path)\n";
+        for (int t = 0; t < params.num_threads; t++) {
+            std::cout << "  " << std::setw(6) << t << std::setw(20) << static_nnz[t]
+                      << std::setw(20) << merge_nnz[t] << "\n";
+        }
+        
+        // Imbalance as the busiest thread relative to the mean
+        auto imbalance = [&](const std::vector<int64_t>& counts) {
+            const double mean = static_cast<double>(std::accumulate(counts.begin(), counts.end(), int64_t{0})) / counts.size();
+            return *std::max_element(counts.begin(), counts.end()) / mean;
+        };
+        std::cout << "  max/mean" << std::setw(18) << std::fixed << std::setprecision(3) << imbalance(static_nnz)
+                  << std::setw(20) << imbalance(merge_nnz) << "\n";
+    }
+    
+    // Run the benchmark
+    timer.start(npb::utils::TimerManager::T_BENCH);
+    npb::utils::RegionProfiler profiler;
+    profiler.enable();
+    npb::utils::PerfCounters counters;
+    if (params.counters) {
+        counters.enable();
+    }
+    double execution_time = matrix.run_benchmark(timer, profiler, counters);
+    timer.stop(npb::utils::TimerManager::T_BENCH);
+    int64_t execution_time_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
+    
+    // Verify the results
+    bool verified = matrix.verify();
+    
+    std::cout << "\n Benchmark completed\n";
+    
+    if (params.problem_class != 'U') {
+        double zeta_verify_value = matrix.get_zeta_verify_value();
+        double zeta = matrix.get_zeta();
+        double err = std::abs((zeta - zeta_verify_value) / zeta_verify_value);
+        
+        if (verified) {
+            std::cout << " VERIFICATION SUCCESSFUL\n";
+            std::cout << " Zeta is    " << std::setw(20) << std::scientific << std::setprecision(13) << zeta << "\n";
+            std::cout << " Error is   " << std::setw(20) << std::scientific << std::setprecision(13) << err << "\n";
+        } else {
+            std::cout << " VERIFICATION FAILED\n";
+            std::cout << " Zeta                " << std::setw(20) << std::scientific << std::setprecision(13) << zeta << "\n";
+            std::cout << " The correct zeta is " << std::setw(20) << std::scientific << std::setprecision(13) << zeta_verify_value << "\n";
+        }
+    } else if (!params.matrix_file.empty()) {
+        std::cout << " Matrix file:       " << params.matrix_file << "\n";
+        std::cout << " Final ||x - A z|| " << std::setw(20) << std::scientific << std::setprecision(13) << matrix.get_rnorm() << "\n";
+        std::cout << " NO VERIFICATION PERFORMED\n";
+    } else {
+        std::cout << " Problem size unknown\n";
+        std::cout << " NO VERIFICATION PERFORMED\n";
+    }
+    
+    // Calculate and print MFLOPS
+    double mflops = matrix.get_mflops(execution_time);
+    
+    if (params.block > 1) {
+        const auto& block_zeta = matrix.get_block_zeta();
+        for (int64_t v = 0; v < params.block; v++) {
+            std::cout << " RHS " << std::setw(4) << v << "  zeta = "
+                      << std::setw(20) << std::scientific << std::setprecision(13) << block_zeta[v] << "\n";
+        }
+        std::cout << " Time per RHS    = " << std::setw(15) << std::fixed << std::setprecision(3)
+                  << execution_time / params.block << " seconds\n";
+        std::cout << " Mop/s per RHS   = " << std::setw(15) << std::fixed << std::setprecision(2)
+                  << mflops / params.block << "\n";
+    }
+    
+    if (params.precision != npb::cg::Precision::fp64) {
+        const auto& stats = matrix.get_refinement_stats();
+        const double solves = std::max<int64_t>(stats.solves, 1);
+        std::cout << " Matrix values   = " << std::setw(15)
+                  << (params.precision == npb::cg::Precision::bf16 ? "bf16" : "fp32") << "\n";
+        std::cout << " Refinements     = " << std::setw(15) << std::fixed << std::setprecision(2)
+                  << stats.refinements / solves << " per solve (max " << stats.max_refinements << ")\n";
+        std::cout << " Inner CG steps  = " << std::setw(15) << stats.inner_iterations / solves << " per solve\n";
+        std::cout << " SpMV bytes      = " << std::setw(15) << stats.spmv_bytes / solves * 1.0e-6
+                  << " MB per solve (fp64: " << stats.reference_bytes / solves * 1.0e-6 << " MB, "
+                  << std::setprecision(1) << 100.0 * (1.0 - stats.spmv_bytes / stats.reference_bytes)
+                  << "% saved)\n";
+    }
+    
+    if (params.preconditioner != npb::cg::PreconditionerKind::none || params.tolerance > 0.0) {
+        const auto& stats = matrix.get_precondition_stats();
+        const auto& preconditioner = matrix.preconditioner();
+        const double solves = std::max<int64_t>(stats.solves, 1);
+        std::cout << " Preconditioner  = " << std::setw(15) << precondition_name(params.preconditioner);
+        if (params.preconditioner == npb::cg::PreconditionerKind::ilu0) {
+            std::cout << " (" << preconditioner.lower_levels() << " lower and "
+                      << preconditioner.upper_levels() << " upper levels)";
+        }
+        std::cout << "\n";
+        if (preconditioner.replaced_pivots() > 0) {
+            std::cout << " Replaced pivots = " << std::setw(15) << preconditioner.replaced_pivots() << "\n";
+        }
+        std::cout << " Setup time      = " << std::setw(15) << std::fixed << std::setprecision(4)
+                  << stats.setup_seconds << " seconds\n";
+        std::cout << " CG iterations   = " << std::setw(15) << std::setprecision(2)
+                  << stats.iterations / solves << " per solve (max " << stats.max_iterations << ")\n";
+        if (params.tolerance > 0.0) {
+            std::cout << " Converged       = " << std::setw(15) << stats.converged << " of " << stats.solves
+                      << " solves to ||r|| <= " << std::scientific << std::setprecision(1) << params.tolerance
+                      << " ||x||\n";
+        }
+        std::cout << " Time per solve  = " << std::setw(15) << std::fixed << std::setprecision(6)
+                  << stats.seconds / solves << " seconds\n";
+    }
+    
+    if (params.cg == npb::cg::CgMethod::sstep) {
+        const auto& stats = matrix.get_sstep_stats();
+        const auto& powers = matrix.matrix_powers();
+        const double solves = std::max<int64_t>(stats.solves, 1);
+        std::cout << " Matrix powers   = ";
+        if (powers.tiled()) {
+            std::cout << std::setw(15) << powers.tiles() << " tiles of " << powers.tile_rows()
+                      << " rows (bandwidth " << powers.bandwidth() << ")\n";
+        } else {
+            // Then every level is its own pass over the matrix, as many as
+            // the classic CG makes, plus the basis and Gram work
+            std::cout << std::setw(15) << "untiled" << " (bandwidth " << powers.bandwidth()
+                      << " too wide for cache-sized tiles)\n";
+            std::cout << "                   no matrix reuse across levels: one pass over A per level,\n"
+                      << "                   so the s-step CG saves reductions but not matrix traffic\n";
+        }
+        std::cout << " CG iterations   = " << std::setw(15) << std::fixed << std::setprecision(2)
+                  << stats.iterations / solves << " per solve\n";
+        std::cout << " Gram reductions = " << std::setw(15) << std::fixed << std::setprecision(2)
+                  << stats.blocks / solves << " per solve (" << stats.short_blocks
+                  << " ended at the Gram rounding floor)\n";
+        std::cout << " Residual gap    = " << std::setw(15) << std::scientific << std::setprecision(3)
+                  << stats.max_gap << " max ||r - (x - A z)|| / ||x|| at a block boundary\n";
+        std::cout << " True residual   = " << std::setw(15) << std::scientific << std::setprecision(3)
+                  << stats.max_residual << " max ||x - A z|| / ||x|| at the end of a solve\n";
+    }
+    
+    // Traffic is modeled only for the classic single right-hand-side solver
+    npb::utils::Throughput achieved;
+    achieved.gflops = mflops * 1.0e-3;
+    if (params.cg == npb::cg::CgMethod::classic && params.block == 1
+        && params.precision == npb::cg::Precision::fp64
+        && params.preconditioner == npb::cg::PreconditionerKind::none && params.tolerance == 0.0
+        && execution_time > 0.0) {
+        achieved.gbs = matrix.get_benchmark_bytes() / execution_time * 1.0e-9;
+    }
+    
+    // Print results
+    npb::utils::print_results(
+        "CG",
+        params.problem_class,
+        params.na,
+        0,
+        0,
+        params.max_iter,
+        execution_time,
+        execution_time_ns,
+        mflops,
+        "floating point",
+        verified,
+        params.num_threads,
+        false,
+        {},
+        roofline ? &*roofline : nullptr,
+        achieved,
+        &counters
+    );
+    
+    // Print timer information
+    if (timer.is_enabled()) {
+        double tmax = timer.read(npb::utils::TimerManager::T_BENCH);
+        int64_t tmax_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
+        if (tmax == 0.0) tmax = 1.0;
+        if (tmax_ns == 0) tmax_ns = 1;
+        
+        std::cout << "  SECTION   Time (secs)       Time (ns)\n";
+        
+        double t = timer.read(npb::utils::TimerManager::T_INIT);
+        int64_t t_ns = timer.read_ns(npb::utils::TimerManager::T_INIT);
+        std::cout << "  init:     " << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                  << "  " << std::setw(15) << t_ns << "\n";
+        
+        t = timer.read(npb::utils::TimerManager::T_BENCH);
+        t_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
+        std::cout << "  benchmark:" << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                  << "  " << std::setw(15) << t_ns
+                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
+        
+        // Per-thread times; the slowest thread bounds the wall time
+        const auto conj_grad = profiler.stats(profiler.region("conj_grad", profiler.region("benchmark")));
+        t = conj_grad.max;
+        t_ns = static_cast<int64_t>(conj_grad.max * 1.0e9);
+        std::cout << "  conj_grad:" << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                  << "  " << std::setw(15) << t_ns
+                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
+        
+        t = tmax - t;
+        t_ns = tmax_ns - t_ns;
+        std::cout << "  rest:     " << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                  << "  " << std::setw(15) << t_ns
+                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
+        
+        if (from_cache) {
+            t = timer.read(npb::utils::TimerManager::T_CACHE);
+            t_ns = timer.read_ns(npb::utils::TimerManager::T_CACHE);
+            std::cout << "  cache:    " << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                      << "  " << std::setw(15) << t_ns << "\n";
+        }
+        
+        if (params.reorder) {
+            // Cost of the reordering in units of one benchmark outer iteration
+            const double iteration = tmax / params.max_iter;
+            t = timer.read(npb::utils::TimerManager::T_REORDER);
+            t_ns = timer.read_ns(npb::utils::TimerManager::T_REORDER);
+            std::cout << "  reorder:  " << std::setw(9) << std::fixed << std::setprecision(3) << t 
+                      << "  " << std::setw(15) << t_ns
+                      << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t / iteration
+                      << " outer iterations)\n";
+        }
+        
+        if (params.profile) {
+            profiler.print();
+        }
+        
+        if (params.phase_timers) {
+            // Achieved rates against the modeled traffic of each phase
+            struct PhaseRow {
+                const char* label;
+                npb::utils::TimerManager::TimerID id;
+            };
+            constexpr PhaseRow phases[] = {
+                {"  spmv:     ", npb::utils::TimerManager::T_SPMV},
+                {"  dot:      ", npb::utils::TimerManager::T_DOT},
+                {"  axpy:     ", npb::utils::TimerManager::T_AXPY},
+            };
+            
+            std::cout << "\n  PHASE     Time (secs)       GB/s     Gflop/s   flop/byte\n";
+            for (const auto& phase : phases) {
+                const auto& traffic = matrix.get_phase_traffic(phase.id);
+                t = timer.read(phase.id);
+                const double seconds = t > 0.0 ? t : 1.0;
+                std::cout << phase.label << std::setw(9) << std::fixed << std::setprecision(3) << t
+                          << std::setw(11) << std::setprecision(2) << traffic.bytes / seconds * 1.0e-9
+                          << std::setw(12) << std::setprecision(3) << traffic.flops / seconds * 1.0e-9
+                          << std::setw(12) << std::setprecision(3)
+                          << (traffic.bytes > 0.0 ? traffic.flops / traffic.bytes : 0.0) << "\n";
+            }
+        }
+    }
+    
+    if (!params.shift_sweep.empty()) {
+        // Each shift patches the diagonal of the matrix assembled above and
+        // reruns the benchmark; shifts other than the class's have no
+        // reference zeta to verify against
+        struct SweepRow {
+            double shift;
+            double zeta;
+            double rnorm;
+            double patch;
+            double bench;
+        };
+        std::vector<SweepRow> rows;
+        
+        for (const double shift : params.shift_sweep) {
+            const auto patch_start = std::chrono::steady_clock::now();
+            try {
+                matrix.set_shift(shift);
+            } catch (const std::exception& e) {
+                std::cerr << "Cannot sweep the shift: " << e.what() << std::endl;
+                return 1;
+            }
+            const auto bench_start = std::chrono::steady_clock::now();
+            matrix.run_benchmark(timer, profiler, counters);
+            const auto bench_end = std::chrono::steady_clock::now();
+            
+            rows.push_back({
+                shift, matrix.get_zeta(), matrix.get_rnorm(),
+                std::chrono::duration<double>(bench_start - patch_start).count(),
+                std::chrono::duration<double>(bench_end - bench_start).count(),
+            });
+        }
+        
+        double patch_total = 0.0;
+        std::cout << "\n Shift sweep on one assembled matrix\n";
+        std::cout << "        shift                 zeta               ||r||   patch (s)   benchmark (s)\n";
+        for (const auto& row : rows) {
+            std::cout << "  " << std::setw(11) << std::fixed << std::setprecision(4) << row.shift
+                      << std::setw(21) << std::scientific << std::setprecision(13) << row.zeta
+                      << std::setw(20) << std::setprecision(6) << row.rnorm
+                      << std::setw(12) << std::fixed << std::setprecision(4) << row.patch
+                      << std::setw(16) << std::setprecision(3) << row.bench << "\n";
+            patch_total += row.patch;
+        }
+        const double assembly = timer.read(npb::utils::TimerManager::T_INIT);
+        std::cout << " " << rows.size() << " shifts: " << std::fixed << std::setprecision(3) << patch_total
+                  << " s of patching instead of " << rows.size() * assembly << " s of initialization\n";
+    }
+    
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
+    npb::utils::start_trace_from_environment("CG");
+
     // Set problem parameters based on class
     char problem_class = 'A';  // Default class
     
@@ -20,14 +436,40 @@ int main(int argc, char** argv) {
     
     // Get thread count from environment or auto-detect
     int num_threads = npb::utils::get_num_threads();
+    bool parallel_generation = false;
+    bool reorder = false;
+    npb::cg::CgMethod cg_method = npb::cg::CgMethod::classic;
+    int64_t block = 1;
+    int64_t sstep = 4;
+    npb::cg::PreconditionerKind preconditioner = npb::cg::PreconditionerKind::none;
+    double tolerance = 0.0;
+    int64_t cg_iterations = 25;
+    std::vector<double> shift_sweep;
+    npb::cg::SstepBasis sstep_basis = npb::cg::SstepBasis::chebyshev;
+    std::string matrix_cache;
+    bool cache_populate = false;
+    bool phase_timers = false;
+    bool roofline = false;
+    bool profile = false;
+    bool counters = false;
+    std::string matrix_file;
+    int64_t niter = 0;
+    int index_width = 0;  // 0 selects the narrowest index that fits
+    npb::cg::AssemblyMethod assembly = npb::cg::AssemblyMethod::insertion;
+    npb::cg::SpmvKernel spmv = npb::cg::SpmvKernel::csr;
+    int64_t sell_sigma = 256;
+    int64_t prefetch_distance = 0;
+    int64_t spmv_tile = 0;
+    npb::cg::Precision precision = npb::cg::Precision::fp64;
+    npb::cg::SellIsa sell_isa = npb::cg::best_sell_isa();
     
     // Parse command line arguments if provided
-    if (argc > 1) {
+    if (argc > 1 && argv[1][0] != '-') {
         // First argument is the problem class
         problem_class = argv[1][0];
         
         // Second argument is the number of threads (if provided)
-        if (argc > 2) {
+        if (argc > 2 && argv[2][0] != '-') {
             num_threads = std::atoi(argv[2]);
             if (num_threads <= 0) {
                 std::cerr << "Invalid thread count: " << argv[2] << std::endl;
@@ -49,6 +491,210 @@ int main(int argc, char** argv) {
                     num_threads = npb::utils::get_num_threads();
                 }
                 i++; // Skip the next argument as it's the thread count value
+            } else if (std::strcmp(argv[i], "--parallel-gen") == 0) {
+                parallel_generation = true;
+            } else if (std::strcmp(argv[i], "--assembly") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "sort") == 0) {
+                    assembly = npb::cg::AssemblyMethod::sorted;
+                } else if (std::strcmp(argv[i+1], "insert") == 0) {
+                    assembly = npb::cg::AssemblyMethod::insertion;
+                } else {
+                    std::cerr << "Invalid assembly method: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid methods are insert, sort" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+                index_width = std::atoi(argv[i+1]);
+                if (index_width != 32 && index_width != 64) {
+                    std::cerr << "Invalid index width: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid widths are 32, 64" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--cg") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "classic") == 0) {
+                    cg_method = npb::cg::CgMethod::classic;
+                } else if (std::strcmp(argv[i+1], "pipelined") == 0) {
+                    cg_method = npb::cg::CgMethod::pipelined;
+                } else if (std::strcmp(argv[i+1], "sstep") == 0) {
+                    cg_method = npb::cg::CgMethod::sstep;
+                } else {
+                    std::cerr << "Invalid CG method: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid methods are classic, pipelined, sstep" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--precond") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "none") == 0) {
+                    preconditioner = npb::cg::PreconditionerKind::none;
+                } else if (std::strcmp(argv[i+1], "jacobi") == 0) {
+                    preconditioner = npb::cg::PreconditionerKind::jacobi;
+                } else if (std::strcmp(argv[i+1], "block-jacobi") == 0) {
+                    preconditioner = npb::cg::PreconditionerKind::block_jacobi;
+                } else if (std::strcmp(argv[i+1], "ilu0") == 0) {
+                    preconditioner = npb::cg::PreconditionerKind::ilu0;
+                } else {
+                    std::cerr << "Invalid preconditioner: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid preconditioners are none, jacobi, block-jacobi, ilu0" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+                tolerance = std::atof(argv[i+1]);
+                if (!(tolerance > 0.0)) {
+                    std::cerr << "Invalid tolerance: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--cg-iter") == 0 && i + 1 < argc) {
+                cg_iterations = std::atoll(argv[i+1]);
+                if (cg_iterations <= 0) {
+                    std::cerr << "Invalid CG iteration count: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--shift-sweep") == 0 && i + 1 < argc) {
+                // Comma-separated list of shifts
+                const char* text = argv[i+1];
+                while (*text != '\0') {
+                    char* end = nullptr;
+                    const double shift = std::strtod(text, &end);
+                    if (end == text || (*end != ',' && *end != '\0')) {
+                        std::cerr << "Invalid shift list: " << argv[i+1] << std::endl;
+                        return 1;
+                    }
+                    shift_sweep.push_back(shift);
+                    text = *end == ',' ? end + 1 : end;
+                }
+                if (shift_sweep.empty()) {
+                    std::cerr << "Invalid shift list: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--sstep") == 0 && i + 1 < argc) {
+                sstep = std::atoll(argv[i+1]);
+                if (sstep < 1 || sstep > 25) {
+                    std::cerr << "Invalid s-step block: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid blocks are 1 to 25 iterations" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--sstep-basis") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "monomial") == 0) {
+                    sstep_basis = npb::cg::SstepBasis::monomial;
+                } else if (std::strcmp(argv[i+1], "chebyshev") == 0) {
+                    sstep_basis = npb::cg::SstepBasis::chebyshev;
+                } else {
+                    std::cerr << "Invalid s-step basis: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid bases are monomial, chebyshev" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+                block = std::atoll(argv[i+1]);
+                if (block <= 0) {
+                    std::cerr << "Invalid block width: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--matrix") == 0 && i + 1 < argc) {
+                matrix_file = argv[i+1];
+                i++;
+            } else if (std::strcmp(argv[i], "--niter") == 0 && i + 1 < argc) {
+                niter = std::atoll(argv[i+1]);
+                if (niter <= 0) {
+                    std::cerr << "Invalid iteration count: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--matrix-cache") == 0 && i + 1 < argc) {
+                matrix_cache = argv[i+1];
+                i++;
+            } else if (std::strcmp(argv[i], "--cache-populate") == 0) {
+                cache_populate = true;
+            } else if (std::strcmp(argv[i], "--profile") == 0) {
+                profile = true;
+            } else if (std::strcmp(argv[i], "--counters") == 0) {
+                counters = true;
+            } else if (std::strcmp(argv[i], "--roofline") == 0) {
+                roofline = true;
+            } else if (std::strcmp(argv[i], "--phase-timers") == 0) {
+                phase_timers = true;
+            } else if (std::strcmp(argv[i], "--reorder") == 0) {
+                reorder = true;
+            } else if (std::strcmp(argv[i], "--spmv") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "csr") == 0) {
+                    spmv = npb::cg::SpmvKernel::csr;
+                } else if (std::strcmp(argv[i+1], "sell") == 0) {
+                    spmv = npb::cg::SpmvKernel::sell;
+                } else if (std::strcmp(argv[i+1], "merge") == 0) {
+                    spmv = npb::cg::SpmvKernel::merge;
+                } else if (std::strcmp(argv[i+1], "symmetric") == 0) {
+                    spmv = npb::cg::SpmvKernel::symmetric;
+                } else if (std::strcmp(argv[i+1], "binned") == 0) {
+                    spmv = npb::cg::SpmvKernel::binned;
+                } else if (std::strcmp(argv[i+1], "prefetch") == 0) {
+                    spmv = npb::cg::SpmvKernel::prefetch;
+                } else if (std::strcmp(argv[i+1], "tiled") == 0) {
+                    spmv = npb::cg::SpmvKernel::tiled;
+                } else {
+                    std::cerr << "Invalid SpMV kernel: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid kernels are csr, sell, merge, symmetric, binned, prefetch, tiled" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--sell-sigma") == 0 && i + 1 < argc) {
+                sell_sigma = std::atoll(argv[i+1]);
+                if (sell_sigma <= 0) {
+                    std::cerr << "Invalid SELL sorting window: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "fp64") == 0) {
+                    precision = npb::cg::Precision::fp64;
+                } else if (std::strcmp(argv[i+1], "fp32") == 0) {
+                    precision = npb::cg::Precision::fp32;
+                } else if (std::strcmp(argv[i+1], "bf16") == 0) {
+                    precision = npb::cg::Precision::bf16;
+                } else {
+                    std::cerr << "Invalid precision: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid precisions are fp64, fp32, bf16" << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--prefetch-distance") == 0 && i + 1 < argc) {
+                prefetch_distance = std::atoll(argv[i+1]);
+                if (prefetch_distance <= 0) {
+                    std::cerr << "Invalid prefetch distance: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--spmv-tile") == 0 && i + 1 < argc) {
+                spmv_tile = std::atoll(argv[i+1]);
+                if (spmv_tile <= 0) {
+                    std::cerr << "Invalid SpMV tile width: " << argv[i+1] << std::endl;
+                    return 1;
+                }
+                i++;
+            } else if (std::strcmp(argv[i], "--sell-isa") == 0 && i + 1 < argc) {
+                if (std::strcmp(argv[i+1], "scalar") == 0) {
+                    sell_isa = npb::cg::SellIsa::scalar;
+                } else if (std::strcmp(argv[i+1], "avx2") == 0) {
+                    sell_isa = npb::cg::SellIsa::avx2;
+                } else if (std::strcmp(argv[i+1], "avx512") == 0) {
+                    sell_isa = npb::cg::SellIsa::avx512;
+                } else {
+                    std::cerr << "Invalid SELL instruction set: " << argv[i+1] << std::endl;
+                    std::cerr << "Valid sets are scalar, avx2, avx512" << std::endl;
+                    return 1;
+                }
+                if (!npb::cg::sell_isa_supported(sell_isa)) {
+                    std::cerr << "Instruction set " << argv[i+1] << " is not supported on this CPU" << std::endl;
+                    return 1;
+                }
+                i++;
             }
         }
     }
@@ -57,8 +703,101 @@ int main(int argc, char** argv) {
     npb::cg::Problem params;
     params.problem_class = problem_class;
     params.num_threads = num_threads;
+    params.parallel_generation = parallel_generation;
+    params.assembly = assembly;
+    params.spmv = spmv;
+    params.sell_sigma = sell_sigma;
+    params.prefetch_distance = prefetch_distance;
+    params.spmv_tile = spmv_tile;
+    params.precision = precision;
+    params.sell_isa = sell_isa;
+    params.reorder = reorder;
+    params.cg = cg_method;
+    params.block = block;
+    params.sstep = sstep;
+    params.sstep_basis = sstep_basis;
+    params.preconditioner = preconditioner;
+    params.tolerance = tolerance;
+    params.cg_iterations = cg_iterations;
+    params.shift_sweep = shift_sweep;
+    params.matrix_cache = matrix_cache;
+    params.cache_populate = cache_populate;
+    params.phase_timers = phase_timers;
+    params.profile = profile;
+    params.counters = counters;
+    
+    if (block > 1 && (spmv != npb::cg::SpmvKernel::csr || cg_method != npb::cg::CgMethod::classic)) {
+        std::cerr << "Block mode supports only --spmv csr with --cg classic" << std::endl;
+        return 1;
+    }
+    if (cg_method == npb::cg::CgMethod::sstep && spmv != npb::cg::SpmvKernel::csr) {
+        std::cerr << "--cg sstep multiplies with its own matrix-powers kernel; use --spmv csr" << std::endl;
+        return 1;
+    }
+    const bool preconditioned = preconditioner != npb::cg::PreconditionerKind::none || tolerance > 0.0;
+    if ((preconditioned || cg_iterations != 25)
+        && (block > 1 || cg_method != npb::cg::CgMethod::classic || precision != npb::cg::Precision::fp64 || phase_timers)) {
+        std::cerr << "--precond, --tolerance and --cg-iter support only --cg classic, "
+                  << "without --block, --precision or --phase-timers" << std::endl;
+        return 1;
+    }
+    if (cg_iterations != 25 && !preconditioned) {
+        std::cerr << "--cg-iter needs --precond or --tolerance" << std::endl;
+        return 1;
+    }
+    if (phase_timers && (block > 1 || cg_method != npb::cg::CgMethod::classic)) {
+        std::cerr << "--phase-timers supports only --cg classic without --block" << std::endl;
+        return 1;
+    }
+    if (precision != npb::cg::Precision::fp64
+        && (block > 1 || cg_method != npb::cg::CgMethod::classic || spmv != npb::cg::SpmvKernel::csr || phase_timers)) {
+        std::cerr << "--precision fp32|bf16 supports only --spmv csr with --cg classic, "
+                  << "without --block or --phase-timers" << std::endl;
+        return 1;
+    }
+    
+    // A Matrix Market file runs as class U, sized by its header
+    npb::cg::MatrixMarketInfo matrix_info;
+    if (!matrix_file.empty()) {
+        try {
+            matrix_info = npb::cg::read_matrix_market_info(matrix_file);
+        } catch (const std::exception& e) {
+            std::cerr << "Cannot read " << matrix_file << ": " << e.what() << std::endl;
+            return 1;
+        }
+        if (matrix_info.rows != matrix_info.cols) {
+            std::cerr << "Matrix " << matrix_file << " is not square" << std::endl;
+            return 1;
+        }
+        if (spmv == npb::cg::SpmvKernel::symmetric && !matrix_info.symmetric) {
+            std::cerr << "--spmv symmetric needs a symmetric matrix" << std::endl;
+            return 1;
+        }
+        if (!matrix_cache.empty()) {
+            std::cerr << "--matrix-cache applies only to generated matrices" << std::endl;
+            return 1;
+        }
+        
+        problem_class = 'U';
+        params.problem_class = 'U';
+        params.matrix_file = matrix_file;
+        params.na = matrix_info.rows;
+        params.nonzer = 0;
+        params.max_iter = niter > 0 ? niter : 15;
+        params.shift = 0.0;
+        params.rcond = 0.0;
+    } else if (niter > 0) {
+        std::cerr << "--niter applies only with --matrix" << std::endl;
+        return 1;
+    }
     
     switch (problem_class) {
+        case 'U':
+            if (matrix_file.empty()) {
+                std::cerr << "Class U needs --matrix FILE" << std::endl;
+                return 1;
+            }
+            break;
         case 'S':
             params.na = 1400;
             params.nonzer = 7;
@@ -114,106 +853,36 @@ int main(int argc, char** argv) {
             return 1;
     }
     
+    const bool fits_32 = matrix_file.empty()
+        ? npb::cg::SparseMatrix32::index_fits(params)
+        : matrix_info.nonzero_bound() <= std::numeric_limits<int32_t>::max();
+    if (index_width == 0) {
+        index_width = fits_32 ? 32 : 64;
+    } else if (index_width == 32 && !fits_32) {
+        std::cerr << "Class " << problem_class << " does not fit a 32-bit index" << std::endl;
+        return 1;
+    }
+    
     // Print benchmark information
     std::cout << "\n\n NAS Parallel Benchmarks C++23 version - CG Benchmark\n\n";
+    if (!matrix_file.empty()) {
+        std::cout << " Matrix: " << matrix_file << " ("
+                  << (matrix_info.symmetric ? "symmetric" : "general") << ", "
+                  << matrix_info.entries << " entries)\n";
+    }
     std::cout << " Size: " << std::setw(11) << params.na << "\n";
     std::cout << " Iterations: " << std::setw(5) << params.max_iter << "\n";
     std::cout << " Threads: " << std::setw(10) << params.num_threads << "\n";
-    
-    // Enable timer for initialization
-    npb::utils::TimerManager timer;
-    timer.enable();
-    timer.start(npb::utils::TimerManager::T_INIT);
-    
-    // Create the sparse matrix
-    npb::cg::SparseMatrix matrix(params);
-    
-    timer.stop(npb::utils::TimerManager::T_INIT);
-std::cout << " Initialization time = " << std::setw(15) << std::fixed << std::setprecision(3) 
-          << timer.read(npb::utils::TimerManager::T_INIT) << " seconds ("
-          << timer.read_ns(npb::utils::TimerManager::T_INIT) << " ns)\n";
-    
-    // Run the benchmark
-    timer.start(npb::utils::TimerManager::T_BENCH);
-    double execution_time = matrix.run_benchmark(timer);
-    timer.stop(npb::utils::TimerManager::T_BENCH);
-    int64_t execution_time_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
-    
-    // Verify the results
-    bool verified = matrix.verify();
-    
-    std::cout << "\n Benchmark completed\n";
-    
-    if (params.problem_class != 'U') {
-        double zeta_verify_value = matrix.get_zeta_verify_value();
-        double zeta = matrix.get_zeta();
-        double err = std::abs((zeta - zeta_verify_value) / zeta_verify_value);
-        
-        if (verified) {
-            std::cout << " VERIFICATION SUCCESSFUL\n";
-            std::cout << " Zeta is    " << std::setw(20) << std::scientific << std::setprecision(13) << zeta << "\n";
-            std::cout << " Error is   " << std::setw(20) << std::scientific << std::setprecision(13) << err << "\n";
-        } else {
-            std::cout << " VERIFICATION FAILED\n";
-            std::cout << " Zeta                " << std::setw(20) << std::scientific << std::setprecision(13) << zeta << "\n";
-            std::cout << " The correct zeta is " << std::setw(20) << std::scientific << std::setprecision(13) << zeta_verify_value << "\n";
-        }
-    } else {
-        std::cout << " Problem size unknown\n";
-        std::cout << " NO VERIFICATION PERFORMED\n";
+    std::cout << " Index width: " << std::setw(6) << index_width << "-bit\n";
+    if (params.block > 1) {
+        std::cout << " Block width: " << std::setw(6) << params.block << "\n";
     }
     
-    // Calculate and print MFLOPS
-    double mflops = matrix.get_mflops(execution_time);
-    
-    // Print results
-    npb::utils::print_results(
-        "CG",
-        params.problem_class,
-        params.na,
-        0,
-        0,
-        params.max_iter,
-        execution_time,
-        execution_time_ns,
-        mflops,
-        "floating point",
-        verified,
-        params.num_threads
-    );
-    
-    // Print timer information
-    if (timer.is_enabled()) {
-        double tmax = timer.read(npb::utils::TimerManager::T_BENCH);
-        int64_t tmax_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
-        if (tmax == 0.0) tmax = 1.0;
-        if (tmax_ns == 0) tmax_ns = 1;
-        
-        std::cout << "  SECTION   Time (secs)       Time (ns)\n";
-        
-        double t = timer.read(npb::utils::TimerManager::T_INIT);
-        int64_t t_ns = timer.read_ns(npb::utils::TimerManager::T_INIT);
-        std::cout << "  init:     " << std::setw(9) << std::fixed << std::setprecision(3) << t 
-                  << "  " << std::setw(15) << t_ns << "\n";
-        
-        t = timer.read(npb::utils::TimerManager::T_BENCH);
-        t_ns = timer.read_ns(npb::utils::TimerManager::T_BENCH);
-        std::cout << "  benchmark:" << std::setw(9) << std::fixed << std::setprecision(3) << t 
-                  << "  " << std::setw(15) << t_ns
-                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
-        
-        t = timer.read(npb::utils::TimerManager::T_CONJ_GRAD);
-        t_ns = timer.read_ns(npb::utils::TimerManager::T_CONJ_GRAD);
-        std::cout << "  conj_grad:" << std::setw(9) << std::fixed << std::setprecision(3) << t 
-                  << "  " << std::setw(15) << t_ns
-                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
-        
-        t = tmax - t;
-        t_ns = tmax_ns - t_ns;
-        std::cout << "  rest:     " << std::setw(9) << std::fixed << std::setprecision(3) << t 
-                  << "  " << std::setw(15) << t_ns
-                  << "  (" << std::setw(6) << std::fixed << std::setprecision(2) << t*100.0/tmax << "%)\n";
+    std::optional<npb::utils::Roofline> ceilings;
+    if (roofline) {
+        ceilings = npb::utils::measure_roofline(params.num_threads);
+        npb::utils::print_roofline(*ceilings);
     }
     
-    return 0;
-}
\ No newline at end of file
+    return index_width == 32 ? run_cg<int32_t>(params, ceilings) : run_cg<int64_t>(params, ceilings);
+}
@@ -0,0 +1,238 @@
+#include "matrix_cache.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace npb::cg {
+
+namespace {
+
+constexpr std::array<char, 8> cache_magic = {'N', 'P', 'B', 'C', 'G', 'C', 'S', 'R'};
+constexpr uint32_t cache_version = 1;
+
+// File layout: header, rowstr[na + 1], colidx[nnz], padding to 8 bytes, a[nnz]
+struct CacheHeader {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t index_bytes;
+    int64_t na;
+    int64_t nonzer;
+    double shift;
+    double rcond;
+    int64_t nnz;
+    uint64_t checksum;
+};
+static_assert(sizeof(CacheHeader) == 64);
+
+struct CacheLayout {
+    size_t rowstr;
+    size_t colidx;
+    size_t a;
+    size_t size;
+};
+
+CacheLayout cache_layout(const int64_t na, const int64_t nnz, const size_t index_bytes) noexcept {
+    CacheLayout layout{};
+    layout.rowstr = sizeof(CacheHeader);
+    layout.colidx = layout.rowstr + (na + 1) * index_bytes;
+    layout.a = (layout.colidx + nnz * index_bytes + 7) / 8 * 8;
+    layout.size = layout.a + nnz * sizeof(double);
+    return layout;
+}
+
+// 64-bit FNV-1a over 8-byte words, chained across the arrays
+uint64_t checksum(const void* data, const size_t bytes, uint64_t hash) noexcept {
+    constexpr uint64_t prime = 0x100000001b3ULL;
+    const auto* p = static_cast<const unsigned char*>(data);
+
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < bytes; i++) {
+        hash = (hash ^ p[i]) * prime;
+    }
+
+    return hash;
+}
+
+constexpr uint64_t checksum_seed = 0xcbf29ce484222325ULL;
+
+bool same_key(const CacheHeader& header, const Problem& params, const size_t index_bytes) noexcept {
+    return header.index_bytes == index_bytes &&
+           header.na == params.na &&
+           header.nonzer == params.nonzer &&
+           std::bit_cast<uint64_t>(header.shift) == std::bit_cast<uint64_t>(params.shift) &&
+           std::bit_cast<uint64_t>(header.rcond) == std::bit_cast<uint64_t>(params.rcond);
+}
+
+} // namespace
+
+std::filesystem::path matrix_cache_path(
+    const std::filesystem::path& dir,
+    const Problem& params,
+    const int index_bytes
+) {
+    // shift and rcond are keyed by their bit patterns so equal keys are exact
+    std::ostringstream name;
+    name << "cg_na" << params.na << "_nz" << params.nonzer
+         << "_s" << std::hex << std::bit_cast<uint64_t>(params.shift)
+         << "_r" << std::bit_cast<uint64_t>(params.rcond)
+         << std::dec << "_i" << 8 * index_bytes << ".csr";
+    return dir / name.str();
+}
+
+template <std::signed_integral Index>
+std::optional<CsrMatrix<Index>> load_matrix_cache(
+    const std::filesystem::path& path,
+    const Problem& params,
+    const bool populate
+) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+        ::close(fd);
+        std::cerr << " Matrix cache: " << path << " is truncated, regenerating" << std::endl;
+        return std::nullopt;
+    }
+    const size_t size = st.st_size;
+
+    int flags = MAP_PRIVATE;
+    #ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+    #endif
+
+    void* base = ::mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << " Matrix cache: cannot map " << path << ", regenerating" << std::endl;
+        return std::nullopt;
+    }
+
+    // Only a hint: file-backed huge pages depend on the filesystem and kernel
+    #ifdef MADV_HUGEPAGE
+    if (populate) {
+        (void)::madvise(base, size, MADV_HUGEPAGE);
+    }
+    #endif
+    (void)::madvise(base, size, MADV_SEQUENTIAL);
+
+    const auto* bytes = static_cast<const unsigned char*>(base);
+    CacheHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+
+    std::optional<CsrMatrix<Index>> csr;
+    const auto layout = cache_layout(header.na, header.nnz, sizeof(Index));
+
+    if (header.magic != cache_magic || header.version != cache_version ||
+        !same_key(header, params, sizeof(Index)) || header.nnz < 0 || layout.size != size) {
+        std::cerr << " Matrix cache: " << path << " does not match this problem, regenerating" << std::endl;
+    } else {
+        uint64_t hash = checksum_seed;
+        hash = checksum(bytes + layout.rowstr, layout.colidx - layout.rowstr, hash);
+        hash = checksum(bytes + layout.colidx, header.nnz * sizeof(Index), hash);
+        hash = checksum(bytes + layout.a, header.nnz * sizeof(double), hash);
+
+        if (hash != header.checksum) {
+            std::cerr << " Matrix cache: checksum mismatch in " << path << ", regenerating" << std::endl;
+        } else {
+            // Copied out rather than used in place: the matrix is mutable
+            // (reordering, derived formats) and owns its storage
+            csr.emplace();
+            csr->rowstr.resize(header.na + 1);
+            csr->colidx.resize(header.nnz);
+            csr->a.resize(header.nnz);
+            std::memcpy(csr->rowstr.data(), bytes + layout.rowstr, csr->rowstr.size() * sizeof(Index));
+            std::memcpy(csr->colidx.data(), bytes + layout.colidx, csr->colidx.size() * sizeof(Index));
+            std::memcpy(csr->a.data(), bytes + layout.a, csr->a.size() * sizeof(double));
+        }
+    }
+
+    ::munmap(base, size);
+    return csr;
+}
+
+template <std::signed_integral Index>
+bool save_matrix_cache(
+    const std::filesystem::path& path,
+    const Problem& params,
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+) {
+    const int64_t nnz = static_cast<int64_t>(colidx.size());
+    const auto layout = cache_layout(params.na, nnz, sizeof(Index));
+
+    CacheHeader header{};
+    header.magic = cache_magic;
+    header.version = cache_version;
+    header.index_bytes = sizeof(Index);
+    header.na = params.na;
+    header.nonzer = params.nonzer;
+    header.shift = params.shift;
+    header.rcond = params.rcond;
+    header.nnz = nnz;
+    header.checksum = checksum(rowstr.data(), rowstr.size_bytes(), checksum_seed);
+    header.checksum = checksum(colidx.data(), colidx.size_bytes(), header.checksum);
+    header.checksum = checksum(a.data(), a.size_bytes(), header.checksum);
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    auto temporary = path;
+    temporary += ".tmp" + std::to_string(::getpid());
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        const std::array<char, 8> padding{};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(rowstr.data()), rowstr.size_bytes());
+        out.write(reinterpret_cast<const char*>(colidx.data()), colidx.size_bytes());
+        out.write(padding.data(), layout.a - (layout.colidx + colidx.size_bytes()));
+        out.write(reinterpret_cast<const char*>(a.data()), a.size_bytes());
+
+        if (!out) {
+            std::filesystem::remove(temporary, ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+
+    return true;
+}
+
+template std::optional<CsrMatrix<int32_t>> load_matrix_cache<int32_t>(
+    const std::filesystem::path&, const Problem&, bool);
+template std::optional<CsrMatrix<int64_t>> load_matrix_cache<int64_t>(
+    const std::filesystem::path&, const Problem&, bool);
+template bool save_matrix_cache<int32_t>(
+    const std::filesystem::path&, const Problem&,
+    std::span<const int32_t>, std::span<const int32_t>, std::span<const double>);
+template bool save_matrix_cache<int64_t>(
+    const std::filesystem::path&, const Problem&,
+    std::span<const int64_t>, std::span<const int64_t>, std::span<const double>);
+
+} // namespace npb::cg
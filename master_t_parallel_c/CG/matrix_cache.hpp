@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cg.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <span>
+
+namespace npb::cg {
+
+// Cache file for the matrix of these parameters, keyed by na, nonzer,
+// shift, rcond and the index width in bytes
+[[nodiscard]] std::filesystem::path matrix_cache_path(
+    const std::filesystem::path& dir,
+    const Problem& params,
+    int index_bytes
+);
+
+// Map a cache file read-only and copy the arrays out. Returns std::nullopt
+// when the file is missing, was written for other parameters, or fails its
+// checksum. populate prefaults the mapping (MAP_POPULATE) and asks for
+// transparent huge pages.
+template <std::signed_integral Index>
+[[nodiscard]] std::optional<CsrMatrix<Index>> load_matrix_cache(
+    const std::filesystem::path& path,
+    const Problem& params,
+    bool populate
+);
+
+// Write a cache file through a temporary renamed into place, so readers
+// never see a partial file. Returns false on I/O errors.
+template <std::signed_integral Index>
+bool save_matrix_cache(
+    const std::filesystem::path& path,
+    const Problem& params,
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+);
+
+} // namespace npb::cg
@@ -0,0 +1,346 @@
+#include "matrix_market.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace npb::cg {
+
+namespace {
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path.string());
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot read " + path.string());
+        }
+        size_ = st.st_size;
+
+        void* base = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error("cannot map " + path.string());
+        }
+        (void)::madvise(base, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(base);
+    }
+
+    ~MappedFile() {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] const char* begin() const noexcept { return data_; }
+    [[nodiscard]] const char* end() const noexcept { return data_ + size_; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+};
+
+struct Entry {
+    int64_t row;
+    int64_t col;
+    double val;
+};
+
+const char* skip_blanks(const char* p, const char* end) noexcept {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+template <typename T>
+bool parse_number(const char*& p, const char* end, T& value) noexcept {
+    p = skip_blanks(p, end);
+    const auto [ptr, ec] = std::from_chars(p, end, value);
+    if (ec != std::errc{}) {
+        return false;
+    }
+    p = ptr;
+    return true;
+}
+
+const char* line_end(const char* p, const char* end) noexcept {
+    const void* eol = std::memchr(p, '\n', end - p);
+    return eol ? static_cast<const char*>(eol) : end;
+}
+
+// Parse the banner, comments and size line of the text in [p, end) and
+// leave p at the first entry line
+MatrixMarketInfo parse_header(const char*& p, const char* end) {
+    const char* eol = line_end(p, end);
+    std::string banner(p, eol);
+    std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+
+    std::istringstream words(banner);
+    std::string tag, object, format, field, symmetry;
+    words >> tag >> object >> format >> field >> symmetry;
+
+    if (tag != "%%matrixmarket" || object != "matrix") {
+        throw std::runtime_error("missing %%MatrixMarket matrix banner");
+    }
+    if (format != "coordinate") {
+        throw std::runtime_error("only coordinate matrices are supported, not " + format);
+    }
+    if (field != "real" && field != "integer" && field != "pattern") {
+        throw std::runtime_error("unsupported field " + field);
+    }
+    if (symmetry != "general" && symmetry != "symmetric") {
+        throw std::runtime_error("unsupported symmetry " + symmetry);
+    }
+
+    MatrixMarketInfo info;
+    info.symmetric = symmetry == "symmetric";
+    info.pattern = field == "pattern";
+
+    // Comments, then the size line
+    p = eol < end ? eol + 1 : end;
+    while (p < end) {
+        eol = line_end(p, end);
+        const char* s = skip_blanks(p, eol);
+        p = eol < end ? eol + 1 : end;
+        if (s == eol || *s == '%') continue;
+
+        if (!parse_number(s, eol, info.rows) || !parse_number(s, eol, info.cols) ||
+            !parse_number(s, eol, info.entries) || info.rows <= 0 || info.cols <= 0 || info.entries < 0) {
+            throw std::runtime_error("malformed size line");
+        }
+        return info;
+    }
+
+    throw std::runtime_error("missing size line");
+}
+
+} // namespace
+
+MatrixMarketInfo read_matrix_market_info(const std::filesystem::path& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("cannot open " + path.string());
+    }
+
+    // The header ends at the size line, the first line that is neither
+    // blank nor a comment (the banner itself starts with %)
+    std::string header;
+    std::string line;
+    while (std::getline(in, line)) {
+        header += line;
+        header += '\n';
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first != std::string::npos && line[first] != '%') {
+            break;
+        }
+    }
+
+    const char* p = header.data();
+    return parse_header(p, header.data() + header.size());
+}
+
+template <std::signed_integral Index>
+CsrMatrix<Index> read_matrix_market(const std::filesystem::path& path, const int num_threads) {
+    const MappedFile file(path);
+    const char* p = file.begin();
+    const MatrixMarketInfo info = parse_header(p, file.end());
+
+    const char* body = p;
+    const char* end = file.end();
+    const size_t body_size = end - body;
+
+    // The shortest entry line is "i j" or "i j v" and a newline, so a size
+    // line claiming more entries than that fits in the body is rejected
+    // before anything is sized from it
+    const int64_t min_line = info.pattern ? 4 : 6;
+    const int64_t max_entries = static_cast<int64_t>((body_size + 1) / min_line);
+    if (info.entries > max_entries) {
+        throw std::runtime_error("expected " + std::to_string(info.entries) +
+                                 " entries, found at most " + std::to_string(max_entries));
+    }
+
+    if (info.nonzero_bound() > std::numeric_limits<Index>::max()) {
+        throw std::runtime_error("matrix does not fit the index type");
+    }
+
+    const int nthreads = std::max(num_threads, 1);
+
+    // Chunk t starts at the first line beginning at or after its even split
+    auto chunk_start = [&](const int t) -> const char* {
+        if (t == 0) return body;
+        if (t == nthreads) return end;
+        const char* q = body + body_size * t / nthreads;
+        const char* eol = line_end(q - 1, end);
+        return eol < end ? eol + 1 : end;
+    };
+
+    std::vector<std::vector<Entry>> parts(nthreads);
+    std::vector<int64_t> stored(nthreads, 0);
+    std::vector<std::string> errors(nthreads);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        #ifdef _OPENMP
+        const int tid = omp_get_thread_num();
+        #else
+        const int tid = 0;
+        #endif
+
+        const char* q = chunk_start(tid);
+        const char* stop = chunk_start(tid + 1);
+        auto& entries = parts[tid];
+
+        // Nothing may throw out of the parallel region; allocation failures
+        // are reported like the parse errors
+        try {
+            entries.reserve(((stop - q) / min_line + 1) * (info.symmetric ? 2 : 1));
+
+            while (q < stop && errors[tid].empty()) {
+                const char* eol = line_end(q, stop);
+                const char* s = skip_blanks(q, eol);
+
+                if (s < eol && *s != '%') {
+                    int64_t i = 0;
+                    int64_t j = 0;
+                    double v = 1.0;
+                    if (!parse_number(s, eol, i) || !parse_number(s, eol, j) ||
+                        (!info.pattern && !parse_number(s, eol, v))) {
+                        errors[tid] = "malformed entry '" + std::string(q, eol) + "'";
+                    } else if (i < 1 || i > info.rows || j < 1 || j > info.cols) {
+                        errors[tid] = "entry out of range '" + std::string(q, eol) + "'";
+                    } else {
+                        entries.push_back({i - 1, j - 1, v});
+                        if (info.symmetric && i != j) {
+                            entries.push_back({j - 1, i - 1, v});
+                        }
+                        stored[tid]++;
+                    }
+                }
+
+                q = eol + 1;
+            }
+        } catch (const std::bad_alloc&) {
+            errors[tid] = "out of memory reading entries";
+        }
+    }
+
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+    int64_t found = 0;
+    for (const int64_t count : stored) {
+        found += count;
+    }
+    if (found != info.entries) {
+        throw std::runtime_error("expected " + std::to_string(info.entries) +
+                                 " entries, found " + std::to_string(found));
+    }
+
+    // Bucket the entries by row, in file order
+    const int64_t rows = info.rows;
+    std::vector<int64_t> row_ptr(rows + 1, 0);
+    for (const auto& entries : parts) {
+        for (const auto& e : entries) {
+            row_ptr[e.row + 1]++;
+        }
+    }
+    for (int64_t i = 0; i < rows; i++) {
+        row_ptr[i + 1] += row_ptr[i];
+    }
+
+    std::vector<int64_t> col(row_ptr[rows]);
+    std::vector<double> val(row_ptr[rows]);
+    {
+        std::vector<int64_t> next(row_ptr.begin(), row_ptr.end() - 1);
+        for (auto& entries : parts) {
+            for (const auto& e : entries) {
+                const int64_t k = next[e.row]++;
+                col[k] = e.col;
+                val[k] = e.val;
+            }
+            std::vector<Entry>().swap(entries);
+        }
+    }
+
+    // Sort each row by column and sum duplicates in place
+    std::vector<int64_t> row_length(rows);
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        std::vector<std::pair<int64_t, double>> row;
+
+        #pragma omp for schedule(dynamic, 256)
+        for (int64_t i = 0; i < rows; i++) {
+            row.clear();
+            for (int64_t k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+                row.emplace_back(col[k], val[k]);
+            }
+            std::stable_sort(row.begin(), row.end(), [](const auto& e1, const auto& e2) {
+                return e1.first < e2.first;
+            });
+
+            int64_t length = 0;
+            for (size_t k = 0; k < row.size(); k++) {
+                if (length > 0 && col[row_ptr[i] + length - 1] == row[k].first) {
+                    val[row_ptr[i] + length - 1] += row[k].second;
+                } else {
+                    col[row_ptr[i] + length] = row[k].first;
+                    val[row_ptr[i] + length] = row[k].second;
+                    length++;
+                }
+            }
+            row_length[i] = length;
+        }
+    }
+
+    CsrMatrix<Index> csr;
+    csr.rowstr.resize(rows + 1);
+    csr.rowstr[0] = 0;
+    for (int64_t i = 0; i < rows; i++) {
+        csr.rowstr[i + 1] = static_cast<Index>(csr.rowstr[i] + row_length[i]);
+    }
+    csr.colidx.resize(csr.rowstr[rows]);
+    csr.a.resize(csr.rowstr[rows]);
+
+    #pragma omp parallel for num_threads(nthreads) schedule(static)
+    for (int64_t i = 0; i < rows; i++) {
+        for (int64_t k = 0; k < row_length[i]; k++) {
+            csr.colidx[csr.rowstr[i] + k] = static_cast<Index>(col[row_ptr[i] + k]);
+            csr.a[csr.rowstr[i] + k] = val[row_ptr[i] + k];
+        }
+    }
+
+    return csr;
+}
+
+template CsrMatrix<int32_t> read_matrix_market<int32_t>(const std::filesystem::path&, int);
+template CsrMatrix<int64_t> read_matrix_market<int64_t>(const std::filesystem::path&, int);
+
+} // namespace npb::cg
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "cg.hpp"
+
+#include <filesystem>
+
+namespace npb::cg {
+
+// Banner and size line of a Matrix Market coordinate file
+struct MatrixMarketInfo {
+    int64_t rows{0};
+    int64_t cols{0};
+    int64_t entries{0};      // entries stored in the file
+    bool symmetric{false};   // only the lower triangle is stored
+    bool pattern{false};     // no values; every entry is 1
+
+    // Nonzeros of the full matrix, counting mirrored entries twice
+    [[nodiscard]] int64_t nonzero_bound() const noexcept {
+        return symmetric ? 2 * entries : entries;
+    }
+};
+
+// Read the banner and size line. Throws std::runtime_error for files that
+// are not real, integer or pattern coordinate matrices, general or
+// symmetric.
+[[nodiscard]] MatrixMarketInfo read_matrix_market_info(const std::filesystem::path& path);
+
+// Memory-map the file and parse its entries in num_threads chunks split at
+// line boundaries. Symmetric entries are mirrored, duplicates summed and
+// columns sorted within rows. Throws std::runtime_error on malformed input.
+template <std::signed_integral Index>
+[[nodiscard]] CsrMatrix<Index> read_matrix_market(const std::filesystem::path& path, int num_threads);
+
+} // namespace npb::cg
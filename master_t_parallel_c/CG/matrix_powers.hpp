@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace npb::cg {
+
+// Matrix-powers kernel of the s-step CG. Row i of basis holds the 2s + 1
+// basis entries [P_0 .. P_s, R_0 .. R_{s-1}] of that row, and each level
+// j adds P_j and R_j from the level below with a three-term recurrence.
+//
+// Rows are cut into tiles of at least the matrix bandwidth, so level j of
+// a tile depends only on level j - 1 of itself and its two neighbours.
+// Each thread sweeps its own tiles in a skewed wavefront that computes
+// every level of a tile while the tiles it reads are still in cache, and
+// then fills in, level by level, the few tiles at its boundaries that need
+// rows of a neighbouring thread. When the bandwidth is too wide for
+// cache-sized tiles, each thread gets a single tile and this reduces to
+// one sweep per level, with the P and R chains still sharing each pass
+// over the matrix.
+template <std::signed_integral Index>
+class MatrixPowers {
+public:
+    // Basis vector j from j - 1 and j - 2: v_j = scale A v_{j-1} + shift v_{j-1} + back v_{j-2}
+    struct Step {
+        double scale;
+        double shift;
+        double back;
+    };
+
+    // Choose the tiles for s-step blocks of s levels on nthreads threads,
+    // sized so a thread's wavefront fits its share of cache_bytes
+    void plan(int64_t nrows, int64_t nnz, int64_t bandwidth, int64_t s, int nthreads, int64_t cache_bytes) noexcept;
+
+    // Levels 1 to levels of the P chain and 1 to levels - 1 of the R chain,
+    // with steps[j - 1] producing level j. Collective: all threads of the
+    // team must call it, and level 0 must be complete for every row. Ends
+    // with a barrier.
+    void compute(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a,
+        double* basis,
+        std::span<const Step> steps,
+        int64_t levels
+    ) const noexcept;
+
+    [[nodiscard]] bool tiled() const noexcept { return tiled_; }
+    [[nodiscard]] int64_t tile_rows() const noexcept { return tile_rows_; }
+    [[nodiscard]] int64_t tiles() const noexcept { return (nrows_ + tile_rows_ - 1) / tile_rows_; }
+    [[nodiscard]] int64_t bandwidth() const noexcept { return bandwidth_; }
+
+private:
+    // Level j of rows [first, last); the R chain only if with_r
+    template <bool with_r>
+    void level_rows(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a,
+        double* basis,
+        const Step& step,
+        int64_t j,
+        int64_t first,
+        int64_t last
+    ) const noexcept;
+
+    int64_t nrows_{0};
+    int64_t s_{1};
+    int64_t width_{3};          // basis entries per row, 2s + 1
+    int64_t bandwidth_{0};
+    int64_t tile_rows_{1};
+    bool tiled_{false};
+};
+
+template <std::signed_integral Index>
+void MatrixPowers<Index>::plan(
+    const int64_t nrows,
+    const int64_t nnz,
+    const int64_t bandwidth,
+    const int64_t s,
+    const int nthreads,
+    const int64_t cache_bytes
+) noexcept {
+    nrows_ = nrows;
+    s_ = s;
+    width_ = 2 * s + 1;
+    bandwidth_ = bandwidth;
+
+    // The wavefront keeps about s + 2 tiles of matrix rows and basis rows
+    // live; give them half of this thread's share of the cache
+    const double row_bytes = static_cast<double>(nnz) / std::max<int64_t>(nrows, 1) * (sizeof(double) + sizeof(Index))
+                           + sizeof(Index) + width_ * sizeof(double);
+    const int64_t cache_rows = static_cast<int64_t>(
+        cache_bytes / (2.0 * std::max(nthreads, 1) * (s + 2) * row_bytes));
+
+    // Tiling pays off only with a few tiles per thread to skew over
+    tiled_ = bandwidth <= cache_rows && nrows >= 2 * std::max(nthreads, 1) * cache_rows;
+    tile_rows_ = tiled_ ? std::max<int64_t>(cache_rows, 1)
+                        : std::max<int64_t>((nrows + nthreads - 1) / std::max(nthreads, 1), 1);
+}
+
+template <std::signed_integral Index>
+template <bool with_r>
+void MatrixPowers<Index>::level_rows(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a,
+    double* basis,
+    const Step& step,
+    const int64_t j,
+    const int64_t first,
+    const int64_t last
+) const noexcept {
+    const int64_t p = j;            // column of P_j
+    const int64_t r = s_ + 1 + j;   // column of R_j
+
+    for (int64_t i = first; i < last; i++) {
+        double sum_p = 0.0;
+        double sum_r = 0.0;
+        for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+            const double* in = basis + static_cast<int64_t>(colidx[k]) * width_;
+            sum_p += a[k] * in[p - 1];
+            if constexpr (with_r) {
+                sum_r += a[k] * in[r - 1];
+            }
+        }
+
+        double* row = basis + i * width_;
+        row[p] = step.scale * sum_p + step.shift * row[p - 1] + (j > 1 ? step.back * row[p - 2] : 0.0);
+        if constexpr (with_r) {
+            row[r] = step.scale * sum_r + step.shift * row[r - 1] + (j > 1 ? step.back * row[r - 2] : 0.0);
+        }
+    }
+}
+
+template <std::signed_integral Index>
+void MatrixPowers<Index>::compute(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a,
+    double* basis,
+    std::span<const Step> steps,
+    const int64_t levels
+) const noexcept {
+    #ifdef _OPENMP
+    const int tid = omp_get_thread_num();
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int tid = 0;
+    const int nthreads = 1;
+    #endif
+
+    const int64_t ntiles = tiles();
+    const int64_t first_tile = ntiles * tid / nthreads;
+    const int64_t last_tile = ntiles * (tid + 1) / nthreads;
+
+    auto level = [&](const int64_t j, const int64_t tile) {
+        const int64_t first = tile * tile_rows_;
+        const int64_t last = std::min(first + tile_rows_, nrows_);
+        if (j < levels) {
+            level_rows<true>(rowstr, colidx, a, basis, steps[j - 1], j, first, last);
+        } else {
+            level_rows<false>(rowstr, colidx, a, basis, steps[j - 1], j, first, last);
+        }
+    };
+
+    // Level j of a tile reads only this thread's tiles when it lies at
+    // least j - 1 tiles inside the thread's range; level 1 reads level 0,
+    // which is complete. At step t the wavefront works on tiles t down to
+    // t - levels + 1, so the tiles it reads were touched a step or two ago.
+    for (int64_t t = first_tile; t < last_tile + levels - 1; t++) {
+        for (int64_t j = 1; j <= levels; j++) {
+            const int64_t tile = t - (j - 1);
+            if (tile >= first_tile + j - 1 && tile < last_tile - j + 1) {
+                level(j, tile);
+            }
+        }
+    }
+
+    // The boundary tiles the wavefront skipped, one level per barrier
+    for (int64_t j = 2; j <= levels; j++) {
+        #pragma omp barrier
+
+        const int64_t inner_first = std::min(first_tile + j - 1, last_tile);
+        const int64_t inner_last = std::max(last_tile - j + 1, inner_first);
+        for (int64_t tile = first_tile; tile < inner_first; tile++) {
+            level(j, tile);
+        }
+        for (int64_t tile = inner_last; tile < last_tile; tile++) {
+            level(j, tile);
+        }
+    }
+
+    #pragma omp barrier
+}
+
+} // namespace npb::cg
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace npb::cg {
+
+enum class PreconditionerKind {
+    none,           // M = I
+    jacobi,         // M = diag(A)
+    block_jacobi,   // dense LDL^T of each diagonal block of block_rows rows
+    ilu0            // incomplete LU on the pattern of A, level-scheduled
+};
+
+// Preconditioner M of the preconditioned CG, built from the CSR matrix. The
+// factors assume A is definite, as the shifted NPB matrix is (negative
+// definite), so every pivot has the sign of the diagonal; a pivot that
+// vanishes is replaced by the diagonal entry and counted.
+//
+// ILU(0) rows depend on the earlier rows they have entries in, so rows are
+// grouped into levels whose rows are independent of each other: the
+// factorization and the forward solve walk the levels of the lower
+// triangle, the backward solve those of the upper triangle, with a barrier
+// between levels. A team of one thread sweeps the rows in order instead.
+template <std::signed_integral Index>
+class Preconditioner {
+public:
+    static constexpr int64_t block_rows = 32;
+
+    void build(
+        PreconditionerKind kind,
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a,
+        int nthreads
+    );
+
+    // z = M^-1 r. Collective: all threads of the team must call it. Ends
+    // with a barrier, so z can be read at any row afterwards.
+    void apply(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        const double* r,
+        double* z
+    ) const noexcept;
+
+    [[nodiscard]] PreconditionerKind kind() const noexcept { return kind_; }
+    [[nodiscard]] int64_t replaced_pivots() const noexcept { return replaced_pivots_; }
+
+    // ILU(0) levels of the lower and upper triangle
+    [[nodiscard]] int64_t lower_levels() const noexcept { return static_cast<int64_t>(lower_ptr_.size()) - 1; }
+    [[nodiscard]] int64_t upper_levels() const noexcept { return static_cast<int64_t>(upper_ptr_.size()) - 1; }
+
+private:
+    // pivot, or the diagonal entry in place of a pivot that vanished
+    // relative to it, counted in replaced
+    [[nodiscard]] static double safe_pivot(double pivot, double diagonal, int64_t& replaced) noexcept;
+
+    void build_jacobi(std::span<const Index> rowstr, std::span<const Index> colidx, std::span<const double> a);
+    void build_block_jacobi(std::span<const Index> rowstr, std::span<const Index> colidx, std::span<const double> a);
+    void build_ilu0(std::span<const Index> rowstr, std::span<const Index> colidx, std::span<const double> a, int nthreads);
+
+    // Group rows by dependency depth; lower looks at columns below the
+    // diagonal, upper at columns above it
+    void build_levels(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        bool lower,
+        std::vector<int64_t>& ptr,
+        std::vector<Index>& rows
+    ) const;
+
+    PreconditionerKind kind_{PreconditionerKind::none};
+    int64_t nrows_{0};
+    int64_t replaced_pivots_{0};
+
+    std::vector<double> inv_diag_;      // Jacobi, and ILU(0) 1 / U_ii
+
+    // Block-Jacobi: per block, L below the diagonal and 1 / D on it,
+    // row-major block_rows x block_rows
+    std::vector<double> blocks_;
+
+    // ILU(0): L (unit, below the diagonal) and U (on and above it) in the
+    // pattern of A, and the level sets of both solves
+    std::vector<double> lu_;
+    std::vector<int64_t> lower_ptr_;
+    std::vector<Index> lower_rows_;
+    std::vector<int64_t> upper_ptr_;
+    std::vector<Index> upper_rows_;
+};
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::build(
+    const PreconditionerKind kind,
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a,
+    const int nthreads
+) {
+    kind_ = kind;
+    nrows_ = static_cast<int64_t>(rowstr.size()) - 1;
+    replaced_pivots_ = 0;
+
+    switch (kind) {
+    case PreconditionerKind::jacobi:
+        build_jacobi(rowstr, colidx, a);
+        break;
+    case PreconditionerKind::block_jacobi:
+        build_block_jacobi(rowstr, colidx, a);
+        break;
+    case PreconditionerKind::ilu0:
+        build_ilu0(rowstr, colidx, a, nthreads);
+        break;
+    case PreconditionerKind::none:
+        break;
+    }
+}
+
+template <std::signed_integral Index>
+double Preconditioner<Index>::safe_pivot(const double pivot, const double diagonal, int64_t& replaced) noexcept {
+    if (std::abs(pivot) > 1.0e-12 * std::abs(diagonal) && pivot != 0.0) {
+        return pivot;
+    }
+    replaced++;
+    return diagonal != 0.0 ? diagonal : 1.0;
+}
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::build_jacobi(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+) {
+    inv_diag_.assign(nrows_, 0.0);
+    for (int64_t i = 0; i < nrows_; i++) {
+        double diagonal = 0.0;
+        for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+            if (colidx[k] == i) {
+                diagonal += a[k];
+            }
+        }
+        inv_diag_[i] = 1.0 / safe_pivot(diagonal, diagonal, replaced_pivots_);
+    }
+}
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::build_block_jacobi(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+) {
+    const int64_t nblocks = (nrows_ + block_rows - 1) / block_rows;
+    blocks_.assign(nblocks * block_rows * block_rows, 0.0);
+
+    int64_t replaced = 0;
+
+    #pragma omp parallel for reduction(+:replaced) schedule(static)
+    for (int64_t b = 0; b < nblocks; b++) {
+        const int64_t first = b * block_rows;
+        const int64_t rows = std::min(block_rows, nrows_ - first);
+        double* f = blocks_.data() + b * block_rows * block_rows;
+
+        // Lower triangle of the block, then a right-looking LDL^T in place:
+        // L below the diagonal and 1 / d on it
+        std::array<double, block_rows> diagonal{};
+        for (int64_t i = 0; i < rows; i++) {
+            for (int64_t k = rowstr[first + i]; k < rowstr[first + i + 1]; k++) {
+                const int64_t j = static_cast<int64_t>(colidx[k]) - first;
+                if (j >= 0 && j <= i) {
+                    f[i * block_rows + j] += a[k];
+                }
+            }
+            diagonal[i] = f[i * block_rows + i];
+        }
+
+        for (int64_t j = 0; j < rows; j++) {
+            const double d = safe_pivot(f[j * block_rows + j], diagonal[j], replaced);
+            for (int64_t i = j + 1; i < rows; i++) {
+                const double l = f[i * block_rows + j] / d;
+                for (int64_t k = j + 1; k <= i; k++) {
+                    f[i * block_rows + k] -= l * f[k * block_rows + j];
+                }
+            }
+            for (int64_t i = j + 1; i < rows; i++) {
+                f[i * block_rows + j] /= d;
+            }
+            f[j * block_rows + j] = 1.0 / d;
+        }
+    }
+
+    replaced_pivots_ += replaced;
+}
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::build_levels(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    const bool lower,
+    std::vector<int64_t>& ptr,
+    std::vector<Index>& rows
+) const {
+    std::vector<int64_t> level(nrows_, 0);
+    int64_t depth = 0;
+
+    auto visit = [&](const int64_t i) {
+        int64_t l = 0;
+        for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+            const int64_t j = colidx[k];
+            if (lower ? j < i : j > i) {
+                l = std::max(l, level[j] + 1);
+            }
+        }
+        level[i] = l;
+        depth = std::max(depth, l + 1);
+    };
+
+    if (lower) {
+        for (int64_t i = 0; i < nrows_; i++) {
+            visit(i);
+        }
+    } else {
+        for (int64_t i = nrows_; i-- > 0;) {
+            visit(i);
+        }
+    }
+
+    // Counting sort by level; rows of a level stay in increasing order
+    ptr.assign(depth + 1, 0);
+    for (int64_t i = 0; i < nrows_; i++) {
+        ptr[level[i] + 1]++;
+    }
+    for (int64_t l = 0; l < depth; l++) {
+        ptr[l + 1] += ptr[l];
+    }
+    std::vector<int64_t> next(ptr.begin(), ptr.end() - 1);
+    rows.resize(nrows_);
+    for (int64_t i = 0; i < nrows_; i++) {
+        rows[next[level[i]]++] = static_cast<Index>(i);
+    }
+}
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::build_ilu0(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a,
+    const int nthreads
+) {
+    build_levels(rowstr, colidx, true, lower_ptr_, lower_rows_);
+    build_levels(rowstr, colidx, false, upper_ptr_, upper_rows_);
+
+    lu_.assign(a.begin(), a.end());
+    inv_diag_.assign(nrows_, 0.0);
+
+    std::vector<int64_t> diag(nrows_, -1);
+    for (int64_t i = 0; i < nrows_; i++) {
+        for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+            if (colidx[k] == i) {
+                diag[i] = k;
+            }
+        }
+    }
+
+    int64_t replaced = 0;
+
+    // IKJ elimination of row i against the finished rows it depends on,
+    // which all lie in earlier levels
+    #pragma omp parallel num_threads(std::max(nthreads, 1)) reduction(+:replaced)
+    {
+        std::vector<int64_t> position(nrows_, -1);
+
+        for (size_t level = 0; level + 1 < lower_ptr_.size(); level++) {
+            #pragma omp for schedule(dynamic, 16)
+            for (int64_t n = lower_ptr_[level]; n < lower_ptr_[level + 1]; n++) {
+                const int64_t i = lower_rows_[n];
+                for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+                    position[colidx[k]] = k;
+                }
+
+                for (int64_t k = rowstr[i]; k < rowstr[i+1] && colidx[k] < i; k++) {
+                    const int64_t c = colidx[k];
+                    lu_[k] *= inv_diag_[c];
+                    for (int64_t m = diag[c] + 1; diag[c] >= 0 && m < rowstr[c+1]; m++) {
+                        const int64_t p = position[colidx[m]];
+                        if (p >= 0) {
+                            lu_[p] -= lu_[k] * lu_[m];
+                        }
+                    }
+                }
+
+                const double diagonal = diag[i] >= 0 ? a[diag[i]] : 0.0;
+                inv_diag_[i] = 1.0 / safe_pivot(diag[i] >= 0 ? lu_[diag[i]] : 0.0, diagonal, replaced);
+
+                for (int64_t k = rowstr[i]; k < rowstr[i+1]; k++) {
+                    position[colidx[k]] = -1;
+                }
+            }
+        }
+    }
+
+    replaced_pivots_ += replaced;
+}
+
+template <std::signed_integral Index>
+void Preconditioner<Index>::apply(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    const double* r,
+    double* z
+) const noexcept {
+    if (kind_ == PreconditionerKind::none || kind_ == PreconditionerKind::jacobi) {
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < nrows_; i++) {
+            z[i] = kind_ == PreconditionerKind::none ? r[i] : r[i] * inv_diag_[i];
+        }
+        return;
+    }
+
+    if (kind_ == PreconditionerKind::block_jacobi) {
+        const int64_t nblocks = (nrows_ + block_rows - 1) / block_rows;
+
+        #pragma omp for schedule(static)
+        for (int64_t b = 0; b < nblocks; b++) {
+            const int64_t first = b * block_rows;
+            const int64_t rows = std::min(block_rows, nrows_ - first);
+            const double* f = blocks_.data() + b * block_rows * block_rows;
+            double* y = z + first;
+
+            for (int64_t i = 0; i < rows; i++) {
+                double sum = r[first + i];
+                for (int64_t k = 0; k < i; k++) {
+                    sum -= f[i * block_rows + k] * y[k];
+                }
+                y[i] = sum;
+            }
+            for (int64_t i = 0; i < rows; i++) {
+                y[i] *= f[i * block_rows + i];
+            }
+            for (int64_t i = rows; i-- > 0;) {
+                double sum = y[i];
+                for (int64_t k = i + 1; k < rows; k++) {
+                    sum -= f[k * block_rows + i] * y[k];
+                }
+                y[i] = sum;
+            }
+        }
+        return;
+    }
+
+    // ILU(0): L y = r, then U z = y, in place in z
+    auto forward = [&](const int64_t i) {
+        double sum = r[i];
+        for (int64_t k = rowstr[i]; k < rowstr[i+1] && colidx[k] < i; k++) {
+            sum -= lu_[k] * z[colidx[k]];
+        }
+        z[i] = sum;
+    };
+    auto backward = [&](const int64_t i) {
+        double sum = z[i];
+        for (int64_t k = rowstr[i+1]; k-- > rowstr[i] && colidx[k] > i;) {
+            sum -= lu_[k] * z[colidx[k]];
+        }
+        z[i] = sum * inv_diag_[i];
+    };
+
+    #ifdef _OPENMP
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int nthreads = 1;
+    #endif
+
+    if (nthreads == 1) {
+        for (int64_t i = 0; i < nrows_; i++) {
+            forward(i);
+        }
+        for (int64_t i = nrows_; i-- > 0;) {
+            backward(i);
+        }
+        return;
+    }
+
+    for (size_t level = 0; level + 1 < lower_ptr_.size(); level++) {
+        #pragma omp for schedule(static)
+        for (int64_t n = lower_ptr_[level]; n < lower_ptr_[level + 1]; n++) {
+            forward(lower_rows_[n]);
+        }
+    }
+    for (size_t level = 0; level + 1 < upper_ptr_.size(); level++) {
+        #pragma omp for schedule(static)
+        for (int64_t n = upper_ptr_[level]; n < upper_ptr_[level + 1]; n++) {
+            backward(upper_rows_[n]);
+        }
+    }
+}
+
+} // namespace npb::cg
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NPB_CG_X86 1
+#endif
+
+namespace npb::cg {
+
+// Instruction set used by the SELL-C-sigma chunk kernel
+enum class SellIsa {
+    scalar,
+    avx2,
+    avx512
+};
+
+[[nodiscard]] inline bool sell_isa_supported(const SellIsa isa) noexcept {
+    switch (isa) {
+        case SellIsa::scalar:
+            return true;
+#ifdef NPB_CG_X86
+        case SellIsa::avx2:
+            return __builtin_cpu_supports("avx2");
+        case SellIsa::avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+[[nodiscard]] inline SellIsa best_sell_isa() noexcept {
+    if (sell_isa_supported(SellIsa::avx512)) return SellIsa::avx512;
+    if (sell_isa_supported(SellIsa::avx2)) return SellIsa::avx2;
+    return SellIsa::scalar;
+}
+
+[[nodiscard]] constexpr const char* sell_isa_name(const SellIsa isa) noexcept {
+    switch (isa) {
+        case SellIsa::avx2:   return "avx2";
+        case SellIsa::avx512: return "avx512";
+        default:              return "scalar";
+    }
+}
+
+// Sliced ELLPACK with sorting windows (SELL-C-sigma). Rows are grouped in
+// chunks of C, and each chunk is stored column-major and padded to its
+// longest row, so one vector lane handles one row. Inside every window of
+// sigma rows the rows are sorted by length first, which keeps the padding
+// small. Each lane accumulates its row in CSR order with separate multiply
+// and add, so results are bit-identical to the scalar CSR loop.
+template <std::signed_integral Index>
+class SellMatrix {
+public:
+    static constexpr int64_t chunk_size = 8;   // C: one AVX-512 vector of doubles
+
+    void build(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a,
+        int64_t sigma,
+        SellIsa isa
+    );
+
+    // y = A x. Orphaned worksharing loop: call it from inside a parallel
+    // region. Rows are permuted across chunks, so the loop keeps its
+    // implicit barrier before y can be read.
+    void multiply(const double* x, double* y) const noexcept;
+
+    [[nodiscard]] int64_t sigma() const noexcept { return sigma_; }
+    [[nodiscard]] SellIsa isa() const noexcept { return isa_; }
+
+    // Stored slots, padding included
+    [[nodiscard]] int64_t slots() const noexcept { return static_cast<int64_t>(val_.size()); }
+
+    // Stored slots relative to the nonzeros (0 means no padding)
+    [[nodiscard]] double padding_ratio() const noexcept {
+        return nnz_ > 0 ? static_cast<double>(val_.size()) / nnz_ - 1.0 : 0.0;
+    }
+
+private:
+    void chunk_scalar(int64_t c, const double* x, double* y) const noexcept;
+#ifdef NPB_CG_X86
+    __attribute__((target("avx2")))
+    void chunk_avx2(int64_t c, const double* x, double* y) const noexcept;
+    __attribute__((target("avx512f")))
+    void chunk_avx512(int64_t c, const double* x, double* y) const noexcept;
+#endif
+
+    void store_chunk(int64_t c, const double* sums, double* y) const noexcept {
+        for (int64_t lane = 0; lane < chunk_size; lane++) {
+            const int64_t row = perm_[c * chunk_size + lane];
+            if (row < nrows_) {
+                y[row] = sums[lane];
+            }
+        }
+    }
+
+    int64_t nrows_{0};
+    int64_t nnz_{0};
+    int64_t nchunks_{0};
+    int64_t sigma_{0};
+    SellIsa isa_{SellIsa::scalar};
+
+    std::vector<int64_t> chunk_ptr_;   // first slot of each chunk
+    std::vector<int64_t> chunk_len_;   // padded row length of each chunk
+    std::vector<Index> perm_;          // original row held by each lane
+    std::vector<Index> col_;           // column indices, column-major per chunk
+    std::vector<double> val_;          // values, column-major per chunk
+};
+
+template <std::signed_integral Index>
+void SellMatrix<Index>::build(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a,
+    int64_t sigma,
+    const SellIsa isa
+) {
+    nrows_ = static_cast<int64_t>(rowstr.size()) - 1;
+    nnz_ = rowstr[nrows_];
+    nchunks_ = (nrows_ + chunk_size - 1) / chunk_size;
+    sigma_ = std::max<int64_t>(chunk_size, sigma / chunk_size * chunk_size);
+    isa_ = isa;
+
+    auto row_length = [&](const int64_t row) { return rowstr[row + 1] - rowstr[row]; };
+
+    // Lanes past the last row keep an out-of-range id and are never stored
+    perm_.resize(nchunks_ * chunk_size);
+    std::iota(perm_.begin(), perm_.end(), Index{0});
+
+    for (int64_t w0 = 0; w0 < nrows_; w0 += sigma_) {
+        const int64_t w1 = std::min(w0 + sigma_, nrows_);
+        std::stable_sort(perm_.begin() + w0, perm_.begin() + w1, [&](Index r1, Index r2) {
+            return row_length(r1) > row_length(r2);
+        });
+    }
+
+    chunk_ptr_.assign(nchunks_ + 1, 0);
+    chunk_len_.assign(nchunks_, 0);
+    for (int64_t c = 0; c < nchunks_; c++) {
+        int64_t len = 0;
+        for (int64_t lane = 0; lane < chunk_size; lane++) {
+            const int64_t row = perm_[c * chunk_size + lane];
+            if (row < nrows_) {
+                len = std::max<int64_t>(len, row_length(row));
+            }
+        }
+        chunk_len_[c] = len;
+        chunk_ptr_[c + 1] = chunk_ptr_[c] + len * chunk_size;
+    }
+
+    // Padding gathers x[0] with a zero value, which leaves the sums unchanged
+    col_.assign(chunk_ptr_[nchunks_], Index{0});
+    val_.assign(chunk_ptr_[nchunks_], 0.0);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t c = 0; c < nchunks_; c++) {
+        for (int64_t lane = 0; lane < chunk_size; lane++) {
+            const int64_t row = perm_[c * chunk_size + lane];
+            if (row >= nrows_) continue;
+
+            for (int64_t k = 0; k < row_length(row); k++) {
+                const int64_t slot = chunk_ptr_[c] + k * chunk_size + lane;
+                col_[slot] = colidx[rowstr[row] + k];
+                val_[slot] = a[rowstr[row] + k];
+            }
+        }
+    }
+}
+
+template <std::signed_integral Index>
+void SellMatrix<Index>::multiply(const double* x, double* y) const noexcept {
+    #pragma omp for schedule(static)
+    for (int64_t c = 0; c < nchunks_; c++) {
+        switch (isa_) {
+#ifdef NPB_CG_X86
+            case SellIsa::avx512:
+                chunk_avx512(c, x, y);
+                break;
+            case SellIsa::avx2:
+                chunk_avx2(c, x, y);
+                break;
+#endif
+            default:
+                chunk_scalar(c, x, y);
+                break;
+        }
+    }
+}
+
+template <std::signed_integral Index>
+void SellMatrix<Index>::chunk_scalar(const int64_t c, const double* x, double* y) const noexcept {
+    double sums[chunk_size] = {};
+    const Index* col = col_.data() + chunk_ptr_[c];
+    const double* val = val_.data() + chunk_ptr_[c];
+
+    for (int64_t k = 0; k < chunk_len_[c]; k++) {
+        for (int64_t lane = 0; lane < chunk_size; lane++) {
+            sums[lane] += val[k * chunk_size + lane] * x[col[k * chunk_size + lane]];
+        }
+    }
+
+    store_chunk(c, sums, y);
+}
+
+#ifdef NPB_CG_X86
+template <std::signed_integral Index>
+__attribute__((target("avx2")))
+void SellMatrix<Index>::chunk_avx2(const int64_t c, const double* x, double* y) const noexcept {
+    __m256d lo = _mm256_setzero_pd();
+    __m256d hi = _mm256_setzero_pd();
+    const Index* col = col_.data() + chunk_ptr_[c];
+    const double* val = val_.data() + chunk_ptr_[c];
+
+    for (int64_t k = 0; k < chunk_len_[c]; k++) {
+        const Index* ck = col + k * chunk_size;
+        __m256d xlo, xhi;
+        if constexpr (sizeof(Index) == 4) {
+            xlo = _mm256_i32gather_pd(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(ck)), 8);
+            xhi = _mm256_i32gather_pd(x, _mm_loadu_si128(reinterpret_cast<const __m128i*>(ck + 4)), 8);
+        } else {
+            xlo = _mm256_i64gather_pd(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ck)), 8);
+            xhi = _mm256_i64gather_pd(x, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ck + 4)), 8);
+        }
+        lo = _mm256_add_pd(lo, _mm256_mul_pd(_mm256_loadu_pd(val + k * chunk_size), xlo));
+        hi = _mm256_add_pd(hi, _mm256_mul_pd(_mm256_loadu_pd(val + k * chunk_size + 4), xhi));
+    }
+
+    alignas(32) double sums[chunk_size];
+    _mm256_store_pd(sums, lo);
+    _mm256_store_pd(sums + 4, hi);
+    store_chunk(c, sums, y);
+}
+
+template <std::signed_integral Index>
+__attribute__((target("avx512f")))
+void SellMatrix<Index>::chunk_avx512(const int64_t c, const double* x, double* y) const noexcept {
+    __m512d acc = _mm512_setzero_pd();
+    const Index* col = col_.data() + chunk_ptr_[c];
+    const double* val = val_.data() + chunk_ptr_[c];
+
+    for (int64_t k = 0; k < chunk_len_[c]; k++) {
+        const Index* ck = col + k * chunk_size;
+        __m512d xk;
+        if constexpr (sizeof(Index) == 4) {
+            xk = _mm512_i32gather_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ck)), x, 8);
+        } else {
+            xk = _mm512_i64gather_pd(_mm512_loadu_si512(ck), x, 8);
+        }
+        acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(val + k * chunk_size), xk));
+    }
+
+    alignas(64) double sums[chunk_size];
+    _mm512_store_pd(sums, acc);
+    store_chunk(c, sums, y);
+}
+#endif
+
+} // namespace npb::cg
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace npb::cg {
+
+// Each symmetric pair a[i][j] = a[j][i] stored once. The rows are cut into
+// one block per thread, and thread t owns the pairs of block t with blocks
+// t + 1 to t + nthreads / 2 (mod nthreads) as well as the upper triangle
+// of its own diagonal block; with an even thread count, the pairs with the
+// opposite block are split between the two by rows. An entry of the pair
+// of blocks t and c adds a[i][j] * x[j] to row i of t and a[i][j] * x[i]
+// to y[j] in c. The work runs in rounds: in round d, thread t handles its
+// pairs with block t + d, so no two threads write the same block of y. The
+// row sums of block t stay in an accumulator of its own and are added to y
+// at the end. Rounds are separated by barriers and each tile runs in a
+// fixed order, so results do not depend on timing, and the conflict state
+// is one accumulator entry per row at any thread count.
+template <std::signed_integral Index>
+class SymmetricMatrix {
+public:
+    // The tiles are cut from rowstr, colidx and a again by every partition,
+    // so they must stay valid until the next build
+    void build(
+        std::span<const Index> rowstr,
+        std::span<const Index> colidx,
+        std::span<const double> a
+    );
+
+    // Split the rows into nthreads blocks of equal size and lay the stored
+    // pairs out in tiles, round by round
+    void partition(int nthreads);
+
+    // y = A x. Orphaned worksharing: call from inside a parallel region; it
+    // ends with a barrier. With a team smaller than the partition, thread t
+    // handles blocks t, t + team size, ...
+    void multiply(const double* x, double* y) noexcept;
+
+    // Stored entries, the diagonal included
+    [[nodiscard]] int64_t nonzeros() const noexcept { return static_cast<int64_t>(val_.size()); }
+
+    // Row pointers over all tiles, and tile rows with at least one entry
+    [[nodiscard]] int64_t pointers() const noexcept { return static_cast<int64_t>(ptr_.size()); }
+    [[nodiscard]] int64_t tile_rows() const noexcept { return tile_rows_; }
+
+    [[nodiscard]] int64_t rounds() const noexcept { return rounds_; }
+
+private:
+    // Rows of the owner's block, columns of the partner block
+    struct Tile {
+        int64_t row_begin;
+        int64_t row_end;
+        int64_t col_begin;
+        int64_t col_end;
+        int64_t ptr;        // first of the tile's row pointers in ptr_
+    };
+
+    int64_t nrows_{0};
+    int64_t nthreads_{0};
+    int64_t rounds_{0};
+    int64_t tile_rows_{0};
+
+    // Full matrix, the source of the tiles
+    std::span<const Index> rowstr_;
+    std::span<const Index> colidx_;
+    std::span<const double> a_;
+
+    std::vector<int64_t> block_begin_;   // first row of each block, plus nrows
+    std::vector<Tile> tiles_;            // round r, thread t at r * nthreads + t
+    std::vector<Index> ptr_;             // row pointers of each tile, plus its end
+    std::vector<Index> col_;             // column indices, tile by tile, row by row
+    std::vector<double> val_;            // values, tile by tile, row by row
+    std::vector<double> sums_;           // row sums of each block until they join y
+};
+
+template <std::signed_integral Index>
+void SymmetricMatrix<Index>::build(
+    std::span<const Index> rowstr,
+    std::span<const Index> colidx,
+    std::span<const double> a
+) {
+    nrows_ = static_cast<int64_t>(rowstr.size()) - 1;
+    rowstr_ = rowstr;
+    colidx_ = colidx;
+    a_ = a;
+
+    // Until partition knows the thread count, store the upper triangle as
+    // a single diagonal tile
+    partition(1);
+}
+
+template <std::signed_integral Index>
+void SymmetricMatrix<Index>::partition(const int nthreads) {
+    const int64_t n = std::max(nthreads, 1);
+    nthreads_ = n;
+    rounds_ = n / 2 + 1;
+
+    block_begin_.resize(n + 1);
+    for (int64_t b = 0; b <= n; b++) {
+        block_begin_[b] = nrows_ * b / n;
+    }
+
+    // Round 0 is the diagonal blocks, round d the pairs (t, t + d). With n
+    // even, round n / 2 would give each opposite pair to both threads: the
+    // lower of the two takes the first half of its rows, and the upper
+    // takes the pair's remaining entries, seen from its own rows.
+    tiles_.assign(rounds_ * n, Tile{});
+    for (int64_t d = 0; d < rounds_; d++) {
+        for (int64_t t = 0; t < n; t++) {
+            const int64_t c = (t + d) % n;
+            Tile tile{block_begin_[t], block_begin_[t + 1], block_begin_[c], block_begin_[c + 1], 0};
+            if (d > 0 && 2 * d == n) {
+                const int64_t lower = std::min(t, c);
+                const int64_t mid = (block_begin_[lower] + block_begin_[lower + 1]) / 2;
+                if (t == lower) {
+                    tile.row_end = mid;
+                } else {
+                    tile.col_begin = mid;
+                }
+            }
+            tiles_[d * n + t] = tile;
+        }
+    }
+
+    // Entries of row i of a tile: its columns in [col_begin, col_end), and
+    // on the diagonal tiles only j >= i; columns are sorted within rows
+    auto segment = [&](const Tile& tile, const int64_t i) {
+        const auto row = colidx_.subspan(rowstr_[i], rowstr_[i + 1] - rowstr_[i]);
+        const int64_t first = tile.col_begin == tile.row_begin && tile.col_end == tile.row_end
+                            ? std::max(i, tile.col_begin) : tile.col_begin;
+        const auto begin = std::lower_bound(row.begin(), row.end(), static_cast<Index>(first));
+        const auto end = std::lower_bound(begin, row.end(), static_cast<Index>(tile.col_end));
+        return std::pair<int64_t, int64_t>{rowstr_[i] + (begin - row.begin()), rowstr_[i] + (end - row.begin())};
+    };
+
+    int64_t pointers = 0;
+    for (Tile& tile : tiles_) {
+        tile.ptr = pointers;
+        pointers += tile.row_end - tile.row_begin + 1;
+    }
+
+    ptr_.assign(pointers, Index{0});
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t t = 0; t < tiles_.size(); t++) {
+        const Tile& tile = tiles_[t];
+        for (int64_t i = tile.row_begin; i < tile.row_end; i++) {
+            const auto [first, last] = segment(tile, i);
+            ptr_[tile.ptr + i - tile.row_begin + 1] = static_cast<Index>(last - first);
+        }
+    }
+
+    Index offset = 0;
+    tile_rows_ = 0;
+    for (const Tile& tile : tiles_) {
+        const int64_t rows = tile.row_end - tile.row_begin;
+        Index* ptr = ptr_.data() + tile.ptr;
+        for (int64_t i = 1; i <= rows; i++) {
+            tile_rows_ += ptr[i] > 0 ? 1 : 0;
+        }
+        ptr[0] = offset;
+        for (int64_t i = 1; i <= rows; i++) {
+            ptr[i] += ptr[i - 1];
+        }
+        offset = ptr[rows];
+    }
+
+    col_.resize(offset);
+    val_.resize(offset);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t t = 0; t < tiles_.size(); t++) {
+        const Tile& tile = tiles_[t];
+        for (int64_t i = tile.row_begin; i < tile.row_end; i++) {
+            const auto [first, last] = segment(tile, i);
+            const int64_t slot = ptr_[tile.ptr + i - tile.row_begin];
+            std::copy(colidx_.begin() + first, colidx_.begin() + last, col_.begin() + slot);
+            std::copy(a_.begin() + first, a_.begin() + last, val_.begin() + slot);
+        }
+    }
+
+    sums_.assign(nrows_, 0.0);
+}
+
+template <std::signed_integral Index>
+void SymmetricMatrix<Index>::multiply(const double* x, double* y) noexcept {
+    #ifdef _OPENMP
+    const int tid = omp_get_thread_num();
+    const int nthreads = omp_get_num_threads();
+    #else
+    const int tid = 0;
+    const int nthreads = 1;
+    #endif
+
+    for (int64_t d = 0; d < rounds_; d++) {
+        for (int64_t owner = tid; owner < nthreads_; owner += nthreads) {
+            const Tile& tile = tiles_[d * nthreads_ + owner];
+            const Index* ptr = ptr_.data() + tile.ptr;
+
+            // Only the owner writes its block of y in round 0, so it clears it first
+            if (d == 0) {
+                std::fill(y + block_begin_[owner], y + block_begin_[owner + 1], 0.0);
+            }
+
+            for (int64_t i = tile.row_begin; i < tile.row_end; i++, ptr++) {
+                if (ptr[0] == ptr[1]) {
+                    if (d == 0) {
+                        sums_[i] = 0.0;
+                    }
+                    continue;
+                }
+
+                const double xi = x[i];
+                double suml = 0.0;
+                for (int64_t k = ptr[0]; k < ptr[1]; k++) {
+                    const int64_t j = col_[k];
+                    suml += val_[k] * x[j];
+                    if (j != i) {
+                        y[j] += val_[k] * xi;
+                    }
+                }
+                sums_[i] = d == 0 ? suml : sums_[i] + suml;
+            }
+        }
+
+        #pragma omp barrier
+    }
+
+    for (int64_t owner = tid; owner < nthreads_; owner += nthreads) {
+        for (int64_t i = block_begin_[owner]; i < block_begin_[owner + 1]; i++) {
+            y[i] += sums_[i];
+        }
+    }
+
+    #pragma omp barrier
+}
+
+} // namespace npb::cg
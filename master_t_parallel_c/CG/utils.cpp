@@ -22,7 +22,10 @@ namespace npb::utils {
         bool verified,
         int num_threads,
         bool with_timers,
-        const std::vector<double>& timers
+        const std::vector<double>& timers,
+        const Roofline* roofline,
+        const Throughput& achieved,
+        const PerfCounters* counters
     ) {
     std::cout << "\n\n " << name << " Benchmark Completed\n";
     std::cout << " Class          =                        " << class_type << "\n";
@@ -73,6 +76,14 @@ namespace npb::utils {
         std::cout << " Verification    =             UNSUCCESSFUL\n";
     }
     
+    if (roofline != nullptr) {
+        print_roofline_summary(*roofline, achieved);
+    }
+    
+    if (counters != nullptr && counters->is_enabled()) {
+        counters->print();
+    }
+    
     // Compiler and system info
     auto now = std::time(nullptr);
     auto tm = *std::localtime(&now);
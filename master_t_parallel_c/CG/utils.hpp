@@ -1,5 +1,8 @@
 #pragma once
 
+#include "perf_counters.hpp"
+#include "roofline.hpp"
+
 #include <chrono>
 #include <string>
 #include <random>
@@ -179,7 +182,11 @@ class Timer {
             enum TimerID {
                 T_INIT,
                 T_BENCH,
-                T_CONJ_GRAD,
+                T_REORDER,
+                T_CACHE,
+                T_SPMV,
+                T_DOT,
+                T_AXPY,
                 T_LAST
             };
         
@@ -242,7 +249,10 @@ void print_results(
     bool verified,
     int num_threads = std::thread::hardware_concurrency(),
     bool with_timers = false,
-    const std::vector<double>& timers = {}
+    const std::vector<double>& timers = {},
+    const Roofline* roofline = nullptr,
+    const Throughput& achieved = {},
+    const PerfCounters* counters = nullptr
 );
 
 template <std::floating_point T, typename Func>
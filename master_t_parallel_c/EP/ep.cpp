@@ -45,6 +45,11 @@ double EPBenchmark::get_mops() const {
     return std::pow(2.0, M + 1) / tm / 1000000.0;
 }
 
+double EPBenchmark::get_flops() const {
+    const double pairs = std::pow(2.0, M);
+    return 16.0 * 2.0 * pairs + 7.0 * pairs + 6.0 * gc;
+}
+
 void EPBenchmark::set_verification_values() {
     switch (M) {
         case 24:
@@ -121,6 +126,9 @@ void EPBenchmark::init() {
 }
 
 void EPBenchmark::worker_task(int tid, int num_workers) {
+    npb::utils::ScopedRegion worker_scope(profiler, worker_region, tid);
+    npb::utils::ScopedCounters worker_counters(counters, tid);
+    
     double local_sx = 0.0;
     double local_sy = 0.0;
     std::vector<double> local_q(NQ, 0.0);
@@ -149,11 +157,14 @@ void EPBenchmark::worker_task(int tid, int num_workers) {
         if (timers_enabled && tid == 0) {
             npb::utils::timer_start(T_SORTING);
         }
+        profiler.begin(generate_region, tid);
         npb::utils::vranlc(2 * NK, &t1, A, x_vec.data());
+        profiler.end(generate_region, tid);
         if (timers_enabled && tid == 0) {
             npb::utils::timer_stop(T_SORTING);
         }
         
+        profiler.begin(gaussian_region, tid);
         for (int i = 0; i < NK; i++) {
             double x1 = 2.0 * x_vec[2*i] - 1.0;
             double x2 = 2.0 * x_vec[2*i+1] - 1.0;
@@ -173,10 +184,13 @@ void EPBenchmark::worker_task(int tid, int num_workers) {
                 }
             }
         }
+        profiler.end(gaussian_region, tid);
     }
     
+    // Includes waiting for the lock
     static std::mutex mtx;
     {
+        npb::utils::ScopedRegion accumulate_scope(profiler, accumulate_region, tid);
         std::lock_guard<std::mutex> lock(mtx);
         sx += local_sx;
         sy += local_sy;
@@ -193,6 +207,13 @@ void EPBenchmark::compute_gaussian_pairs() {
     
     k_offset = -1;
     
+    profiler.reset(num_threads);
+    worker_region = profiler.region("workers");
+    generate_region = profiler.region("generate", worker_region);
+    gaussian_region = profiler.region("gaussian", worker_region);
+    accumulate_region = profiler.region("accumulate", worker_region);
+    counters.reset(num_threads);
+    
     npb::utils::timer_start(T_BENCHMARKING);
     
     std::vector<std::thread> threads;
@@ -292,6 +313,10 @@ void EPBenchmark::print_results() const {
         std::cout << " Random numbers : " << std::setw(9) << std::setprecision(3) << t 
                   << " (" << std::setw(5) << std::setprecision(2) << (t * 100.0 / tt) << "%)\n";
     }
+    
+    if (profiler.is_enabled()) {
+        profiler.print();
+    }
 }
 
 }
\ No newline at end of file
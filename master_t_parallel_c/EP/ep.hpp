@@ -1,5 +1,8 @@
 #pragma once
 
+#include "perf_counters.hpp"
+#include "profiler.hpp"
+
 #include <array>
 #include <cmath>
 #include <cstdint>
@@ -35,6 +38,16 @@ public:
     void print_results() const;
     bool verify() const;
     double get_mops() const;
+    
+    // Record per-thread regions of the workers and print them with the results
+    void enable_profile() { profiler.enable(); }
+    // Count hardware events of each worker over its whole task
+    void enable_counters() { counters.enable(); }
+    const npb::utils::PerfCounters& get_counters() const { return counters; }
+    // Modeled multiplies and adds of the run: 16 per random number in
+    // vranlc, 7 per pair to map and test it, 6 per accepted Gaussian pair
+    // (log and sqrt not counted)
+    double get_flops() const;
 
 private:
     static constexpr int T_BENCHMARKING = 0;
@@ -70,6 +83,13 @@ private:
     bool verified = false;
     bool timers_enabled = false;
     
+    npb::utils::RegionProfiler profiler;
+    int worker_region = 0;
+    int generate_region = 0;
+    int gaussian_region = 0;
+    int accumulate_region = 0;
+    npb::utils::PerfCounters counters;
+    
     void init();
     void compute_gaussian_pairs();
     bool verify_results();
@@ -6,8 +6,11 @@
 #include <string>
 #include <chrono>
 #include <cstdlib>
+#include <optional>
 
 int main(int argc, char** argv) {
+    npb::utils::start_trace_from_environment("EP");
+
     // Set problem parameters based on class
     char problem_class = 'S';  // Default class
     
@@ -19,6 +22,10 @@ int main(int argc, char** argv) {
     // Get thread count from environment or auto-detect
     int num_threads = npb::utils::get_num_threads();
     
+    bool roofline = false;
+    bool profile = false;
+    bool counters = false;
+    
     // Parse command line arguments if provided
     if (argc >= 2) {
         // Check if the first argument is a single character class identifier
@@ -42,6 +49,12 @@ int main(int argc, char** argv) {
             if ((argv[i][1] == 't' || strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
                 num_threads = std::atoi(argv[i+1]);
                 i++; // Skip the next argument as it's the thread count value
+            } else if (strcmp(argv[i], "--profile") == 0) {
+                profile = true;
+            } else if (strcmp(argv[i], "--counters") == 0) {
+                counters = true;
+            } else if (strcmp(argv[i], "--roofline") == 0) {
+                roofline = true;
             } else if (strcmp(argv[i], "--no-header") == 0) {
                 // Skip header printing - handled by the utility function
             } else if ((argv[i][1] == 'c' || strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--class") == 0) && i + 1 < argc) {
@@ -90,6 +103,12 @@ int main(int argc, char** argv) {
     std::cout << " Size: 2^" << std::setw(2) << m << " random numbers\n";
     std::cout << " Threads: " << std::setw(10) << num_threads << "\n";
     
+    std::optional<npb::utils::Roofline> ceilings;
+    if (roofline) {
+        ceilings = npb::utils::measure_roofline(num_threads);
+        npb::utils::print_roofline(*ceilings);
+    }
+    
     // Enable timer for initialization
     npb::utils::TimerManager timer;
     timer.enable();
@@ -97,6 +116,12 @@ int main(int argc, char** argv) {
     
     // Create and initialize the benchmark
     npb::EPBenchmark benchmark(problem_class, num_threads);
+    if (profile) {
+        benchmark.enable_profile();
+    }
+    if (counters) {
+        benchmark.enable_counters();
+    }
     
     timer.stop(npb::utils::TimerManager::T_INIT);
     std::cout << " Initialization time = " << std::setw(15) << std::fixed << std::setprecision(3) 
@@ -125,6 +150,12 @@ int main(int argc, char** argv) {
     // Calculate and print MOPS
     double mops = benchmark.get_mops();
     
+    // EP streams no arrays, so only its flop rate is set against the roofline
+    npb::utils::Throughput achieved;
+    if (execution_time > 0.0) {
+        achieved.gflops = benchmark.get_flops() / execution_time * 1.0e-9;
+    }
+    
     // Print results
     npb::utils::print_results(
         "EP",
@@ -138,7 +169,12 @@ int main(int argc, char** argv) {
         mops,
         "Random number generation",
         verified,
-        num_threads
+        num_threads,
+        false,
+        {},
+        ceilings ? &*ceilings : nullptr,
+        achieved,
+        &benchmark.get_counters()
     );
     
     // Print timer information
@@ -59,7 +59,10 @@ namespace utils
         bool verified,
         int num_threads,
         bool with_timers,
-        const std::vector<double>& timers
+        const std::vector<double>& timers,
+        const Roofline* roofline,
+        const Throughput& achieved,
+        const PerfCounters* counters
     ) {
     std::cout << "\n\n " << name << " Benchmark Completed\n";
     std::cout << " Class          =                        " << class_type << "\n";
@@ -110,6 +113,14 @@ namespace utils
         std::cout << " Verification    =             UNSUCCESSFUL\n";
     }
     
+    if (roofline != nullptr) {
+        print_roofline_summary(*roofline, achieved);
+    }
+    
+    if (counters != nullptr && counters->is_enabled()) {
+        counters->print();
+    }
+    
     // Compiler and system info
     auto now = std::time(nullptr);
     auto tm = *std::localtime(&now);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "perf_counters.hpp"
+#include "roofline.hpp"
+
 #include <chrono>
 #include <string>
 #include <random>
@@ -230,7 +233,10 @@ void print_results(
     bool verified,
     int num_threads = std::thread::hardware_concurrency(),
     bool with_timers = false,
-    const std::vector<double>& timers = {}
+    const std::vector<double>& timers = {},
+    const Roofline* roofline = nullptr,
+    const Throughput& achieved = {},
+    const PerfCounters* counters = nullptr
 );
 
 // Templated utility functions for parallel operations
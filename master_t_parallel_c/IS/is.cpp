@@ -140,9 +140,18 @@ void IntegerSort<KeyType>::run() {
         create_seq(314159265.0, 1220703125.0);
     }
     
+    rank_region_ = profiler_.region("rank");
+    count_region_ = profiler_.region("count", rank_region_);
+    scatter_region_ = profiler_.region("scatter", rank_region_);
+    bucket_rank_region_ = profiler_.region("bucket_rank", rank_region_);
+    
     rank(1);
     passed_verification_ = 0;
     
+    // Only the timed iterations are profiled
+    profiler_.reset(omp_get_max_threads());
+    counters_.reset(omp_get_max_threads());
+    
     if (params_.class_id != 'S') {
         std::cout << "\n   iteration\n";
     }
@@ -279,7 +288,11 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
         const int thread_id = omp_get_thread_num();
         const int num_threads = omp_get_num_threads();
         KeyType* work_buff = bucket_size_[thread_id].data();
+        npb::utils::ScopedRegion rank_scope(profiler_, rank_region_, thread_id);
+        npb::utils::ScopedCounters rank_counters(counters_, thread_id);
         
+        // Regions end before each barrier, so waiting shows as imbalance
+        profiler_.begin(count_region_, thread_id);
         for (int i = 0; i < params_.num_buckets; ++i) {
             work_buff[i] = 0;
         }
@@ -291,6 +304,7 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
                 ++work_buff[bucket_idx];
             }
         }
+        profiler_.end(count_region_, thread_id);
         
         #pragma omp barrier
         
@@ -307,6 +321,7 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
         
         #pragma omp barrier
         
+        profiler_.begin(scatter_region_, thread_id);
         std::vector<KeyType> my_bucket_start(params_.num_buckets);
         for (int i = 0; i < params_.num_buckets; i++) {
             my_bucket_start[i] = bucket_ptrs_[i];
@@ -323,6 +338,7 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
                 key_buff2_[my_bucket_start[bucket_idx]++] = k;
             }
         }
+        profiler_.end(scatter_region_, thread_id);
         
         #pragma omp barrier
         
@@ -339,7 +355,8 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
             }
         }
         
-        #pragma omp for schedule(dynamic)
+        profiler_.begin(bucket_rank_region_, thread_id);
+        #pragma omp for schedule(dynamic) nowait
         for (int i = 0; i < params_.num_buckets; ++i) {
             const KeyType k1 = i * num_bucket_keys;
             const KeyType k2 = std::min(k1 + num_bucket_keys, static_cast<KeyType>(params_.max_key));
@@ -363,6 +380,7 @@ void IntegerSort<KeyType>::rank_with_buckets(int iteration) {
                 key_buff_ptr[k] += key_buff_ptr[k-1];
             }
         }
+        profiler_.end(bucket_rank_region_, thread_id);
     }
 }
 
@@ -602,9 +620,17 @@ bool IntegerSort<KeyType>::getVerificationStatus() const noexcept {
     return verified_;
 }
 
+template<std::integral KeyType>
+double IntegerSort<KeyType>::getModeledBytes() const noexcept {
+    const double keys = static_cast<double>(params_.total_keys);
+    const double histogram = static_cast<double>(params_.max_key);
+    return params_.iterations * sizeof(KeyType) * (4.0 * keys + 3.0 * histogram);
+}
+
 template<std::integral KeyType>
 void print_results(const IntegerSort<KeyType>& is, const ISParameters<KeyType>& params, 
-                  std::string_view name, std::string_view optype) {
+                  std::string_view name, std::string_view optype,
+                  const npb::utils::Roofline* roofline) {
     const auto mops = is.getMopsTotal();
     const auto t = is.getExecutionTime();
     const auto verified = is.getVerificationStatus();
@@ -632,6 +658,19 @@ void print_results(const IntegerSort<KeyType>& is, const ISParameters<KeyType>&
     std::cout << " Operation type  = " << std::setw(24) << optype << "\n";
     std::cout << " Verification    =               " << (verified ? "SUCCESSFUL" : "UNSUCCESSFUL") << "\n";
     
+    // IS does no floating-point work, so only its bandwidth is reported
+    if (roofline != nullptr) {
+        npb::utils::Throughput achieved;
+        if (t > 0.0) {
+            achieved.gbs = is.getModeledBytes() / t * 1.0e-9;
+        }
+        npb::utils::print_roofline_summary(*roofline, achieved);
+    }
+    
+    if (is.getCounters().is_enabled()) {
+        is.getCounters().print();
+    }
+    
     // Version, compiler info and dates
     std::cout << " Version         =             " << std::setw(12) << "4.1" << "\n";
     
@@ -674,6 +713,10 @@ void print_results(const IntegerSort<KeyType>& is, const ISParameters<KeyType>&
               << "          " << init_time_ns << "\n";
     std::cout << "  benchmark:    " << std::fixed << std::setprecision(3) << std::setw(5) << t 
               << "          " << time_ns << "  (100.00%)\n";
+    
+    if (is.getProfiler().is_enabled()) {
+        is.getProfiler().print();
+    }
 }
 
 } // namespace is
@@ -683,4 +726,4 @@ void print_results(const IntegerSort<KeyType>& is, const ISParameters<KeyType>&
 template class npb::is::IntegerSort<int64_t>;
 template npb::is::ISParameters<int64_t> npb::is::load_parameters<int64_t>(char);
 template void npb::is::print_results<int64_t>(const npb::is::IntegerSort<int64_t>&, const npb::is::ISParameters<int64_t>&, 
-                 std::string_view, std::string_view);
\ No newline at end of file
+                 std::string_view, std::string_view, const npb::utils::Roofline*);
\ No newline at end of file
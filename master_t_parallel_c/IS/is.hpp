@@ -1,5 +1,9 @@
 #pragma once
 
+#include "perf_counters.hpp"
+#include "profiler.hpp"
+#include "roofline.hpp"
+
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -49,6 +53,11 @@ public:
     [[nodiscard]] double getExecutionTime() const noexcept;
     [[nodiscard]] double getMopsTotal() const noexcept;
     [[nodiscard]] bool getVerificationStatus() const noexcept;
+    // Modeled memory traffic of the timed iterations: per rank the keys are
+    // read twice and scattered to and read back from key_buff2, and the
+    // key_buff1 histogram is cleared and prefix-summed; increments into a
+    // bucket's cache-resident histogram slice are not counted
+    [[nodiscard]] double getModeledBytes() const noexcept;
     [[nodiscard]] double getTimer(int timer_id) const noexcept {
         if (timer_id >= 0 && timer_id < timer_values_.size()) {
             return timer_values_[timer_id];
@@ -58,6 +67,22 @@ public:
     [[nodiscard]] bool getUseBuckets() const noexcept {
         return use_buckets;
     }
+    
+    // Record per-thread regions of the timed rank iterations
+    void enableProfile() noexcept {
+        profiler_.enable();
+    }
+    [[nodiscard]] const npb::utils::RegionProfiler& getProfiler() const noexcept {
+        return profiler_;
+    }
+    
+    // Count hardware events of each thread over the timed rank iterations
+    void enableCounters() noexcept {
+        counters_.enable();
+    }
+    [[nodiscard]] const npb::utils::PerfCounters& getCounters() const noexcept {
+        return counters_;
+    }
 
 private:
     class RandomGenerator {
@@ -117,6 +142,13 @@ private:
     std::vector<KeyType*> key_buff1_aptr_;
     
     std::array<double, 4> timer_values_{};
+    
+    npb::utils::RegionProfiler profiler_;
+    int rank_region_ = 0;
+    int count_region_ = 0;
+    int scatter_region_ = 0;
+    int bucket_rank_region_ = 0;
+    npb::utils::PerfCounters counters_;
 };
 
 template<std::integral KeyType = int64_t>
@@ -124,7 +156,8 @@ ISParameters<KeyType> load_parameters(char class_id = 'S');
 
 template<std::integral KeyType = int64_t>
 void print_results(const IntegerSort<KeyType>& is, const ISParameters<KeyType>& params, 
-                  std::string_view name, std::string_view optype);
+                  std::string_view name, std::string_view optype,
+                  const npb::utils::Roofline* roofline = nullptr);
 
 using ISParameters64 = ISParameters<int64_t>;
 using IntegerSort64 = IntegerSort<int64_t>;
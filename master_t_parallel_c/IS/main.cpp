@@ -6,13 +6,31 @@
 #include <cctype>
 #include <stdexcept>
 #include <iomanip>
+#include <cstring>
+#include <optional>
 
 int main(int argc, char** argv) {
+    npb::utils::start_trace_from_environment("IS");
+
     char class_id = 'S'; // Default class
     int num_threads = omp_get_max_threads(); // Default to max threads
+    bool roofline = false;
+    bool profile = false;
+    bool counters = false;
+    
+    // Options may follow the positional arguments
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--roofline") == 0) {
+            roofline = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        }
+    }
     
     // Process command line arguments
-    if (argc > 1) {
+    if (argc > 1 && argv[1][0] != '-') {
         std::string class_arg_str = argv[1];
         if (class_arg_str.length() == 1 && std::isalpha(class_arg_str[0])) {
             class_id = std::toupper(class_arg_str[0]);
@@ -21,7 +39,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (argc > 2) {
+    if (argc > 2 && argv[2][0] != '-') {
         try {
             num_threads = std::stoi(argv[2]);
             if (num_threads <= 0) {
@@ -43,6 +61,12 @@ int main(int argc, char** argv) {
     
     // Create the IntegerSort object first
     npb::is::IntegerSort<int64_t> is(params);
+    if (profile) {
+        is.enableProfile();
+    }
+    if (counters) {
+        is.enableCounters();
+    }
     
     std::cout << "\n\n NAS Parallel Benchmarks 4.1 Modern C++20 with OpenMP - IS Benchmark\n\n";
     std::cout << " Class: " << class_id << "\n";
@@ -51,6 +75,13 @@ int main(int argc, char** argv) {
     std::cout << " Threads requested: " << num_threads << ", Threads used: " << omp_get_num_threads() << "\n";
     std::cout << " Using bucket sort: " << (is.getUseBuckets() ? "YES" : "NO") << "\n\n";
     
+    std::optional<npb::utils::Roofline> ceilings;
+    if (roofline) {
+        ceilings = npb::utils::measure_roofline(num_threads);
+        npb::utils::print_roofline(*ceilings);
+        std::cout << "\n";
+    }
+    
     // Now we can reference the 'is' object because it's already initialized
     std::cout << " Initialization time =           " << std::fixed << std::setprecision(3) 
               << is.getTimer(params.T_INITIALIZATION) << " seconds (" 
@@ -62,7 +93,7 @@ int main(int argc, char** argv) {
     is.run();
     
     // Print results
-    npb::is::print_results(is, params, "IS", "keys ranked");
+    npb::is::print_results(is, params, "IS", "keys ranked", ceilings ? &*ceilings : nullptr);
     
     return 0;
 }
\ No newline at end of file
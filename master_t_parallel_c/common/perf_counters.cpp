@@ -0,0 +1,261 @@
+#include "perf_counters.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+namespace npb::utils {
+
+namespace {
+
+constexpr std::array<const char*, PerfCounters::num_events> event_names = {
+    "CYCLES", "INSTR", "LLC-MISS", "DTLB-MISS", "STALLED"
+};
+
+#ifdef __linux__
+
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cache_event(const uint64_t cache, const uint64_t op, const uint64_t result) {
+    return cache | (op << 8) | (result << 16);
+}
+
+constexpr std::array<EventConfig, PerfCounters::num_events> event_configs = {{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                     PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+}};
+
+// Counts user-space events of the calling thread only, which is what an
+// unprivileged process may open with perf_event_paranoid up to 2
+int open_event(const EventConfig& event) noexcept {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+int current_thread() noexcept {
+    return static_cast<int>(::syscall(SYS_gettid));
+}
+
+#else
+
+int current_thread() noexcept {
+    return 1;
+}
+
+#endif
+
+} // namespace
+
+PerfCounters::~PerfCounters() {
+    for (Slot& slot : slots_) {
+        close(slot);
+    }
+}
+
+void PerfCounters::reset(const int num_threads) {
+    for (Slot& slot : slots_) {
+        close(slot);
+    }
+    slots_.assign(static_cast<size_t>(std::max(num_threads, 1)), Slot{});
+}
+
+void PerfCounters::open(Slot& slot, const int owner) noexcept {
+    close(slot);
+    slot.owner = owner;
+
+    #ifdef __linux__
+    for (int e = 0; e < num_events; e++) {
+        slot.fd[e] = open_event(event_configs[e]);
+        if (slot.fd[e] < 0 && slot.error == 0) {
+            slot.error = errno;
+        }
+    }
+    #else
+    slot.error = ENOSYS;
+    #endif
+}
+
+void PerfCounters::close(Slot& slot) noexcept {
+    for (int& fd : slot.fd) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+void PerfCounters::start(const int tid) noexcept {
+    if (!enabled_ || tid >= static_cast<int>(slots_.size())) {
+        return;
+    }
+
+    // Counters follow the kernel thread that opened them, so reopen them if
+    // this slot now runs on a different thread
+    Slot& slot = slots_[tid];
+    const int self = current_thread();
+    if (slot.owner != self) {
+        open(slot, self);
+    }
+
+    for (int e = 0; e < num_events; e++) {
+        if (slot.fd[e] >= 0 && ::read(slot.fd[e], &slot.start[e], sizeof(Reading)) != sizeof(Reading)) {
+            close(slot);
+            return;
+        }
+    }
+}
+
+void PerfCounters::stop(const int tid) noexcept {
+    if (!enabled_ || tid >= static_cast<int>(slots_.size())) {
+        return;
+    }
+
+    Slot& slot = slots_[tid];
+    for (int e = 0; e < num_events; e++) {
+        Reading now;
+        if (slot.fd[e] < 0 || ::read(slot.fd[e], &now, sizeof(Reading)) != sizeof(Reading)) {
+            continue;
+        }
+
+        // With more events than hardware counters the kernel time-slices
+        // them; scale the count up to the whole interval
+        double count = static_cast<double>(now.value - slot.start[e].value);
+        const uint64_t enabled = now.enabled - slot.start[e].enabled;
+        const uint64_t running = now.running - slot.start[e].running;
+        if (running > 0 && running < enabled) {
+            count *= static_cast<double>(enabled) / running;
+            slot.multiplexed = true;
+        }
+
+        slot.total[e] += count;
+        slot.counted = true;
+    }
+}
+
+int64_t PerfCounters::read(const Event event, const int tid) const noexcept {
+    if (tid >= static_cast<int>(slots_.size())) {
+        return -1;
+    }
+    const Slot& slot = slots_[tid];
+    if (!slot.counted || slot.fd[event] < 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(slot.total[event]);
+}
+
+void PerfCounters::print() const {
+    const int num_threads = static_cast<int>(slots_.size());
+
+    std::array<int64_t, num_events> total{};
+    std::array<bool, num_events> available{};
+    bool multiplexed = false;
+    int error = 0;
+    for (int tid = 0; tid < num_threads; tid++) {
+        for (int e = 0; e < num_events; e++) {
+            const int64_t count = read(static_cast<Event>(e), tid);
+            if (count >= 0) {
+                total[e] += count;
+                available[e] = true;
+            }
+        }
+        multiplexed = multiplexed || slots_[tid].multiplexed;
+        if (error == 0) {
+            error = slots_[tid].error;
+        }
+    }
+
+    if (std::none_of(available.begin(), available.end(), [](const bool a) { return a; })) {
+        std::cout << "\n Hardware counters: unavailable";
+        if (error == EACCES || error == EPERM) {
+            std::cout << " (perf_event_open: " << std::strerror(error)
+                      << "; see /proc/sys/kernel/perf_event_paranoid)";
+        } else if (error != 0) {
+            std::cout << " (perf_event_open: " << std::strerror(error)
+                      << "; no hardware PMU exposed to this system?)";
+        }
+        std::cout << "\n";
+        return;
+    }
+
+    auto print_row = [&](const std::array<int64_t, num_events>& counts) {
+        for (int e = 0; e < num_events; e++) {
+            if (counts[e] >= 0) {
+                std::cout << std::setw(15) << counts[e];
+            } else {
+                std::cout << std::setw(15) << "n/a";
+            }
+            if (e == instructions) {
+                if (counts[cycles] > 0 && counts[instructions] >= 0) {
+                    std::cout << std::setw(7) << std::fixed << std::setprecision(2)
+                              << static_cast<double>(counts[instructions]) / counts[cycles];
+                } else {
+                    std::cout << std::setw(7) << "n/a";
+                }
+            }
+        }
+        std::cout << "\n";
+    };
+
+    std::cout << "\n Hardware counters (user space, timed region):\n";
+    std::cout << "  " << std::left << std::setw(8) << "THREAD" << std::right;
+    for (int e = 0; e < num_events; e++) {
+        std::cout << std::setw(15) << event_names[e];
+        if (e == instructions) {
+            std::cout << std::setw(7) << "IPC";
+        }
+    }
+    std::cout << "\n";
+
+    for (int tid = 0; tid < num_threads; tid++) {
+        if (!slots_[tid].counted) {
+            continue;
+        }
+        std::array<int64_t, num_events> counts;
+        for (int e = 0; e < num_events; e++) {
+            counts[e] = read(static_cast<Event>(e), tid);
+        }
+        std::cout << "  " << std::left << std::setw(8) << tid << std::right;
+        print_row(counts);
+    }
+
+    for (int e = 0; e < num_events; e++) {
+        if (!available[e]) {
+            total[e] = -1;
+        }
+    }
+    std::cout << "  " << std::left << std::setw(8) << "total" << std::right;
+    print_row(total);
+
+    if (multiplexed) {
+        std::cout << "  (events were time-multiplexed; counts are scaled estimates)\n";
+    }
+    if (error != 0) {
+        std::cout << "  (n/a: perf_event_open: " << std::strerror(error) << ")\n";
+    }
+}
+
+} // namespace npb::utils
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "profiler.hpp"
+
+namespace npb::utils {
+
+// Hardware event counts of each thread over a timed region, read in-process
+// through perf_event_open so initialization is not mixed in as it is with
+// perf stat around the whole run. Every thread opens its own user-space
+// counters the first time it starts them and accumulates into its own
+// cache-line-padded slot. Events the kernel or the CPU refuses are left
+// out and reported as unavailable; the benchmark runs unchanged.
+class PerfCounters {
+public:
+    enum Event {
+        cycles,
+        instructions,
+        llc_misses,
+        dtlb_misses,
+        stalled_cycles,     // backend stalls
+        num_events
+    };
+
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Size the slots for num_threads threads, closing any open counters and
+    // clearing all totals. Not thread-safe; call outside parallel regions.
+    void reset(int num_threads);
+
+    void enable() noexcept { enabled_ = true; }
+    [[nodiscard]] bool is_enabled() const noexcept { return enabled_; }
+
+    // Start and stop counting on the calling thread, which must be thread
+    // tid for the whole region
+    void start(int tid) noexcept;
+    void stop(int tid) noexcept;
+
+    // Count of event on thread tid, or -1 if it could not be measured
+    [[nodiscard]] int64_t read(Event event, int tid) const noexcept;
+
+    // Table of the counts per thread and their total
+    void print() const;
+
+private:
+    // value, time enabled and time running, as read from the counter
+    struct Reading {
+        uint64_t value{0};
+        uint64_t enabled{0};
+        uint64_t running{0};
+    };
+
+    struct alignas(64) Slot {
+        int owner{0};           // kernel thread id the counters belong to
+        std::array<int, num_events> fd{-1, -1, -1, -1, -1};
+        std::array<Reading, num_events> start{};
+        std::array<double, num_events> total{};
+        bool counted{false};
+        bool multiplexed{false};    // some event was scaled for time not counting
+        int error{0};               // errno of the first event that failed to open
+    };
+
+    static void open(Slot& slot, int owner) noexcept;
+    static void close(Slot& slot) noexcept;
+
+    bool enabled_{false};
+    std::vector<Slot> slots_;
+};
+
+// Counts hardware events over the enclosing scope on the calling thread
+class ScopedCounters {
+public:
+    ScopedCounters(PerfCounters& counters, const int tid = thread_id()) noexcept
+        : counters_(counters), tid_(tid) {
+        counters_.start(tid_);
+    }
+
+    ~ScopedCounters() { counters_.stop(tid_); }
+
+    ScopedCounters(const ScopedCounters&) = delete;
+    ScopedCounters& operator=(const ScopedCounters&) = delete;
+
+private:
+    PerfCounters& counters_;
+    int tid_;
+};
+
+} // namespace npb::utils
@@ -0,0 +1,107 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace npb::utils {
+
+void RegionProfiler::reset(const int num_threads) {
+    num_threads_ = std::max(num_threads, 1);
+    slots_.assign(static_cast<size_t>(num_threads_) * max_regions, Slot{});
+}
+
+int RegionProfiler::region(const std::string& name, const int parent) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t id = 0; id < regions_.size(); id++) {
+        if (regions_[id].parent == parent && regions_[id].name == name) {
+            return static_cast<int>(id);
+        }
+    }
+
+    if (regions_.size() == max_regions) {
+        throw std::length_error("too many profiler regions");
+    }
+    regions_.push_back({name, parent, trace_name(name)});
+    return static_cast<int>(regions_.size() - 1);
+}
+
+double RegionProfiler::read(const int id, const int tid) const noexcept {
+    if (tid >= num_threads_) {
+        return 0.0;
+    }
+    return slot(id, tid).total_ns / 1.0e9;
+}
+
+RegionProfiler::Stats RegionProfiler::stats(const int id) const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.name = regions_[id].name;
+        for (int p = regions_[id].parent; p >= 0; p = regions_[p].parent) {
+            stats.depth++;
+        }
+    }
+
+    double sum = 0.0;
+    stats.min = std::numeric_limits<double>::max();
+    for (int tid = 0; tid < num_threads_; tid++) {
+        const Slot& s = slot(id, tid);
+        if (s.calls == 0) {
+            continue;
+        }
+        const double seconds = s.total_ns / 1.0e9;
+        stats.threads++;
+        stats.calls = std::max(stats.calls, s.calls);
+        stats.min = std::min(stats.min, seconds);
+        stats.max = std::max(stats.max, seconds);
+        sum += seconds;
+    }
+
+    if (stats.threads == 0) {
+        stats.min = 0.0;
+        return stats;
+    }
+
+    stats.mean = sum / stats.threads;
+    stats.imbalance = stats.mean > 0.0 ? stats.max / stats.mean : 1.0;
+    stats.wait = stats.max - stats.mean;
+    return stats;
+}
+
+void RegionProfiler::print_children(const int parent) const {
+    for (size_t id = 0; id < regions_.size(); id++) {
+        if (regions_[id].parent != parent) {
+            continue;
+        }
+
+        const Stats s = stats(static_cast<int>(id));
+        if (s.threads > 0) {
+            const std::string label = std::string(2 * s.depth, ' ') + s.name + ":";
+            std::cout << "  " << std::left << std::setw(16) << label << std::right
+                      << std::setw(4) << s.threads
+                      << std::setw(9) << s.calls
+                      << std::fixed << std::setprecision(4)
+                      << std::setw(11) << s.min
+                      << std::setw(11) << s.mean
+                      << std::setw(11) << s.max
+                      << std::setw(8) << std::setprecision(3) << s.imbalance
+                      << std::setw(11) << std::setprecision(4) << s.wait << "\n";
+        }
+
+        print_children(static_cast<int>(id));
+    }
+}
+
+void RegionProfiler::print() const {
+    std::cout << "\n  " << std::left << std::setw(16) << "REGION" << std::right
+              << std::setw(4) << "THR" << std::setw(9) << "CALLS"
+              << std::setw(11) << "MIN (s)" << std::setw(11) << "MEAN (s)" << std::setw(11) << "MAX (s)"
+              << std::setw(8) << "IMBAL" << std::setw(11) << "WAIT (s)" << "\n";
+    print_children(-1);
+}
+
+} // namespace npb::utils
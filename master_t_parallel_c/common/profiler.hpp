@@ -0,0 +1,143 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "trace.hpp"
+
+namespace npb::utils {
+
+// Thread number inside an OpenMP parallel region, 0 outside
+[[nodiscard]] inline int thread_id() noexcept {
+    #ifdef _OPENMP
+    return omp_get_thread_num();
+    #else
+    return 0;
+    #endif
+}
+
+// Per-thread timing of named, nested regions. Each benchmark registers its
+// own regions and refers to them by the returned id, so there is no shared
+// list to extend. Every thread accumulates into its own cache-line-padded
+// slot per region: begin and end touch no shared state and never
+// synchronize. Totals are compared across threads only when reporting.
+// When tracing is on, every begin and end is also recorded as a trace event,
+// whether or not timing is enabled.
+class RegionProfiler {
+public:
+    static constexpr int max_regions = 64;
+
+    // Aggregate of one region over the threads that entered it
+    struct Stats {
+        std::string name;
+        int depth{0};           // nesting level below the top-level regions
+        int threads{0};         // threads that entered the region
+        int64_t calls{0};       // most entries by a single thread
+        double min{0.0};        // per-thread total seconds
+        double mean{0.0};
+        double max{0.0};
+        double imbalance{0.0};  // max / mean
+        double wait{0.0};       // max - mean: average time a thread waits
+                                // for the slowest at the closing barrier
+    };
+
+    // Size the slots for num_threads threads and clear all totals. Not
+    // thread-safe; call outside parallel regions.
+    void reset(int num_threads);
+
+    void enable() noexcept { enabled_ = true; }
+    [[nodiscard]] bool is_enabled() const noexcept { return enabled_; }
+
+    // Id of region name below parent (-1 for a top-level region),
+    // registering it on first use. Thread-safe, but meant to be called
+    // before the timed code rather than inside it.
+    [[nodiscard]] int region(const std::string& name, int parent = -1);
+
+    void begin(const int id, const int tid) noexcept {
+        if (enabled_ && tid < num_threads_) {
+            slot(id, tid).start_ns = now_ns();
+        }
+        if (trace_enabled) [[unlikely]] {
+            trace_begin(regions_[id].trace_name);
+        }
+    }
+
+    void end(const int id, const int tid) noexcept {
+        if (enabled_ && tid < num_threads_) {
+            Slot& s = slot(id, tid);
+            s.total_ns += now_ns() - s.start_ns;
+            s.calls++;
+        }
+        if (trace_enabled) [[unlikely]] {
+            trace_end(regions_[id].trace_name);
+        }
+    }
+
+    // Total seconds thread tid spent in region id
+    [[nodiscard]] double read(int id, int tid) const noexcept;
+
+    [[nodiscard]] Stats stats(int id) const;
+
+    // Table of every region entered, children indented below their parent
+    void print() const;
+
+private:
+    struct alignas(64) Slot {
+        int64_t total_ns{0};
+        int64_t calls{0};
+        int64_t start_ns{0};
+    };
+
+    struct Region {
+        std::string name;
+        int parent;
+        const char* trace_name;
+    };
+
+    [[nodiscard]] static int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    [[nodiscard]] Slot& slot(const int id, const int tid) noexcept {
+        return slots_[static_cast<size_t>(tid) * max_regions + id];
+    }
+    [[nodiscard]] const Slot& slot(const int id, const int tid) const noexcept {
+        return slots_[static_cast<size_t>(tid) * max_regions + id];
+    }
+
+    void print_children(int parent) const;
+
+    bool enabled_{false};
+    int num_threads_{0};
+    std::vector<Slot> slots_;   // max_regions slots per thread, thread-major
+    std::vector<Region> regions_;
+    mutable std::mutex mutex_;
+};
+
+// Times the enclosing scope as region id on the calling thread
+class ScopedRegion {
+public:
+    ScopedRegion(RegionProfiler& profiler, const int id, const int tid = thread_id()) noexcept
+        : profiler_(profiler), id_(id), tid_(tid) {
+        profiler_.begin(id_, tid_);
+    }
+
+    ~ScopedRegion() { profiler_.end(id_, tid_); }
+
+    ScopedRegion(const ScopedRegion&) = delete;
+    ScopedRegion& operator=(const ScopedRegion&) = delete;
+
+private:
+    RegionProfiler& profiler_;
+    int id_;
+    int tid_;
+};
+
+} // namespace npb::utils
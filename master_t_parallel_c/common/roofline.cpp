@@ -0,0 +1,189 @@
+#include "roofline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace npb::utils {
+
+namespace {
+
+constexpr int stream_repetitions = 5;
+constexpr int fma_repetitions = 3;
+
+// Independent FMA chains per thread: enough 8-wide registers to cover the
+// FMA latency on two ports
+constexpr int fma_lanes = 128;
+constexpr int64_t fma_iterations = 20'000'000;
+
+volatile double fma_sink;
+
+double seconds_since(const std::chrono::steady_clock::time_point start) noexcept {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Three arrays, each a few times the last-level cache so the loops stream
+// from memory, but at most a sixteenth of physical memory
+int64_t stream_elements() noexcept {
+    constexpr int64_t min_bytes = int64_t{64} << 20;
+    int64_t bytes = std::max(4 * last_level_cache_bytes(), min_bytes);
+
+    const long pages = ::sysconf(_SC_PHYS_PAGES);
+    const long page_size = ::sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) {
+        bytes = std::min(bytes, std::max(static_cast<int64_t>(pages) * page_size / 16, min_bytes));
+    }
+
+    return bytes / static_cast<int64_t>(sizeof(double));
+}
+
+double peak_fma_gflops(const int num_threads) {
+    double best = std::numeric_limits<double>::max();
+    double sink = 0.0;
+
+    for (int rep = 0; rep < fma_repetitions; rep++) {
+        const auto start = std::chrono::steady_clock::now();
+
+        #pragma omp parallel num_threads(num_threads) reduction(+:sink)
+        {
+            // acc converges to add / (1 - mul) = 1, so it never overflows
+            // or goes subnormal
+            volatile double opaque_mul = 0.999999;
+            volatile double opaque_add = 1.0e-6;
+            const double mul = opaque_mul;
+            const double add = opaque_add;
+
+            alignas(64) double acc[fma_lanes];
+            for (int k = 0; k < fma_lanes; k++) {
+                acc[k] = 1.0 + k * 1.0e-3;
+            }
+
+            for (int64_t i = 0; i < fma_iterations; i++) {
+                #pragma omp simd aligned(acc : 64)
+                for (int k = 0; k < fma_lanes; k++) {
+                    acc[k] = std::fma(acc[k], mul, add);
+                }
+            }
+
+            for (int k = 0; k < fma_lanes; k++) {
+                sink += acc[k];
+            }
+        }
+
+        best = std::min(best, seconds_since(start));
+    }
+
+    // Keep the loop from being discarded
+    fma_sink = sink;
+
+    return 2.0 * fma_lanes * fma_iterations * num_threads / best * 1.0e-9;
+}
+
+} // namespace
+
+int64_t last_level_cache_bytes() noexcept {
+    for (const int name : {_SC_LEVEL3_CACHE_SIZE, _SC_LEVEL2_CACHE_SIZE}) {
+        const long size = ::sysconf(name);
+        if (size > 0) {
+            return size;
+        }
+    }
+    return int64_t{32} << 20;
+}
+
+Roofline measure_roofline(const int num_threads) {
+    Roofline roofline;
+    roofline.num_threads = std::max(num_threads, 1);
+
+    const int64_t n = stream_elements();
+    roofline.array_bytes = n * static_cast<int64_t>(sizeof(double));
+
+    // Uninitialized storage, first touched by the same static schedule the
+    // kernels use so pages land next to the threads that stream them
+    std::unique_ptr<double[]> a(new double[n]);
+    std::unique_ptr<double[]> b(new double[n]);
+    std::unique_ptr<double[]> c(new double[n]);
+    double* pa = a.get();
+    double* pb = b.get();
+    double* pc = c.get();
+    const double scalar = 3.0;
+
+    #pragma omp parallel for num_threads(roofline.num_threads) schedule(static)
+    for (int64_t i = 0; i < n; i++) {
+        pa[i] = 1.0;
+        pb[i] = 2.0;
+        pc[i] = 0.0;
+    }
+
+    double copy_time = std::numeric_limits<double>::max();
+    double triad_time = std::numeric_limits<double>::max();
+
+    for (int rep = 0; rep < stream_repetitions; rep++) {
+        auto start = std::chrono::steady_clock::now();
+        #pragma omp parallel for num_threads(roofline.num_threads) schedule(static)
+        for (int64_t i = 0; i < n; i++) {
+            pc[i] = pa[i];
+        }
+        copy_time = std::min(copy_time, seconds_since(start));
+
+        start = std::chrono::steady_clock::now();
+        #pragma omp parallel for num_threads(roofline.num_threads) schedule(static)
+        for (int64_t i = 0; i < n; i++) {
+            pa[i] = pb[i] + scalar * pc[i];
+        }
+        triad_time = std::min(triad_time, seconds_since(start));
+    }
+
+    const double bytes = static_cast<double>(roofline.array_bytes);
+    roofline.copy_gbs = 2.0 * bytes / copy_time * 1.0e-9;
+    roofline.triad_gbs = 3.0 * bytes / triad_time * 1.0e-9;
+    roofline.peak_gflops = peak_fma_gflops(roofline.num_threads);
+
+    return roofline;
+}
+
+void print_roofline(const Roofline& roofline) {
+    std::cout << " Roofline probe: copy " << std::fixed << std::setprecision(2) << roofline.copy_gbs
+              << " GB/s, triad " << roofline.triad_gbs
+              << " GB/s, peak FMA " << roofline.peak_gflops << " Gflop/s ("
+              << roofline.num_threads << " threads, 3 x " << (roofline.array_bytes >> 20) << " MiB arrays)\n";
+}
+
+void print_roofline_summary(const Roofline& roofline, const Throughput& achieved) {
+    std::cout << "\n Roofline:\n";
+    std::cout << "    STREAM copy  = " << std::setw(12) << std::fixed << std::setprecision(2)
+              << roofline.copy_gbs << " GB/s\n";
+    std::cout << "    STREAM triad = " << std::setw(12) << roofline.triad_gbs << " GB/s\n";
+    std::cout << "    Peak FMA     = " << std::setw(12) << roofline.peak_gflops << " Gflop/s\n";
+
+    if (achieved.gbs > 0.0) {
+        std::cout << "    Achieved     = " << std::setw(12) << std::setprecision(2) << achieved.gbs
+                  << " GB/s    (" << std::setw(5) << std::setprecision(1)
+                  << 100.0 * achieved.gbs / roofline.triad_gbs << "% of triad)\n";
+    }
+    if (achieved.gflops > 0.0) {
+        std::cout << "    Achieved     = " << std::setw(12) << std::setprecision(2) << achieved.gflops
+                  << " Gflop/s (" << std::setw(5) << std::setprecision(1)
+                  << 100.0 * achieved.gflops / roofline.peak_gflops << "% of peak)\n";
+    }
+    if (achieved.gbs > 0.0 && achieved.gflops > 0.0) {
+        const double intensity = achieved.gflops / achieved.gbs;
+        const double memory_roof = intensity * roofline.triad_gbs;
+        const bool memory_bound = memory_roof < roofline.peak_gflops;
+        std::cout << "    Intensity    = " << std::setw(12) << std::setprecision(3) << intensity << " flop/byte\n";
+        std::cout << "    Attainable   = " << std::setw(12) << std::setprecision(2)
+                  << std::min(memory_roof, roofline.peak_gflops) << " Gflop/s ("
+                  << (memory_bound ? "memory" : "compute") << " bound)\n";
+    }
+}
+
+} // namespace npb::utils
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace npb::utils {
+
+// Machine ceilings measured by measure_roofline
+struct Roofline {
+    int num_threads{1};
+    int64_t array_bytes{0};     // size of each STREAM array
+    double copy_gbs{0.0};       // STREAM copy, c = a
+    double triad_gbs{0.0};      // STREAM triad, a = b + s * c
+    double peak_gflops{0.0};    // independent FMA chains held in registers
+};
+
+// Rates achieved by a benchmark run. A zero field has no model and is not
+// reported.
+struct Throughput {
+    double gbs{0.0};
+    double gflops{0.0};
+};
+
+// Size of the last-level data cache in bytes, or a 32 MiB guess when the
+// system does not report one
+[[nodiscard]] int64_t last_level_cache_bytes() noexcept;
+
+// Run STREAM copy and triad over arrays a few times the last-level cache,
+// then a peak-FMA loop, all with num_threads OpenMP threads. Bytes are
+// counted as STREAM does, without write-allocate traffic. Each rate is the
+// best of several repetitions.
+[[nodiscard]] Roofline measure_roofline(int num_threads);
+
+// One-line summary of the ceilings, printed when the probe runs
+void print_roofline(const Roofline& roofline);
+
+// Achieved rates as fractions of the ceilings. With both rates known, also
+// the arithmetic intensity and the attainable rate min(peak, intensity *
+// triad) with the roof that bounds it.
+void print_roofline_summary(const Roofline& roofline, const Throughput& achieved);
+
+} // namespace npb::utils
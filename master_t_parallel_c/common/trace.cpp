@@ -0,0 +1,141 @@
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace npb::utils {
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t ns;     // since the trace started
+    char phase;     // 'B' or 'E'
+};
+
+// Events of one thread, written only by that thread
+struct ThreadTrace {
+    int index;
+    std::vector<TraceEvent> events;
+};
+
+struct TraceState {
+    std::string path;
+    std::string process_name;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mutex;                                    // guards threads and names
+    std::vector<std::unique_ptr<ThreadTrace>> threads;   // outlive their threads
+    std::deque<std::string> names;                       // never moved once added
+};
+
+TraceState& state() {
+    static TraceState instance;
+    return instance;
+}
+
+ThreadTrace& thread_trace() {
+    thread_local ThreadTrace* trace = nullptr;
+    if (trace == nullptr) {
+        auto& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.threads.push_back(std::make_unique<ThreadTrace>());
+        trace = s.threads.back().get();
+        trace->index = static_cast<int>(s.threads.size() - 1);
+        trace->events.reserve(1 << 16);
+    }
+    return *trace;
+}
+
+void record(const char* name, const char phase) noexcept {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - state().start).count();
+    thread_trace().events.push_back({name, ns, phase});
+}
+
+std::string json_string(const std::string& text) {
+    std::string quoted = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void write_trace() {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    std::ofstream out(s.path);
+    if (!out) {
+        std::cerr << " Cannot write trace " << s.path << std::endl;
+        return;
+    }
+
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":"
+        << json_string(s.process_name) << "}}";
+
+    size_t count = 0;
+    out << std::fixed << std::setprecision(3);
+    for (const auto& thread : s.threads) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->index
+            << ",\"args\":{\"name\":\"thread " << thread->index << "\"}}";
+        for (const auto& event : thread->events) {
+            out << ",\n{\"name\":" << json_string(event.name) << ",\"ph\":\"" << event.phase
+                << "\",\"ts\":" << event.ns / 1.0e3 << ",\"pid\":1,\"tid\":" << thread->index << "}";
+        }
+        count += thread->events.size();
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    std::cerr << " Trace: " << count << " events from " << s.threads.size()
+              << " threads written to " << s.path << std::endl;
+}
+
+} // namespace
+
+void start_trace_from_environment(const char* process_name) {
+    const char* path = std::getenv("NPB_TRACE");
+    if (path == nullptr || *path == '\0') {
+        return;
+    }
+
+    auto& s = state();
+    s.path = path;
+    s.process_name = process_name;
+    s.start = std::chrono::steady_clock::now();
+    std::atexit(write_trace);
+    trace_enabled = true;
+}
+
+const char* trace_name(const std::string& name) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (const auto& interned : s.names) {
+        if (interned == name) {
+            return interned.c_str();
+        }
+    }
+    return s.names.emplace_back(name).c_str();
+}
+
+void trace_begin(const char* name) noexcept {
+    record(name, 'B');
+}
+
+void trace_end(const char* name) noexcept {
+    record(name, 'E');
+}
+
+} // namespace npb::utils
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+namespace npb::utils {
+
+// Set once at startup by start_trace_from_environment and only read
+// afterwards, so the check on every region entry and exit is a branch that
+// always goes the same way
+inline bool trace_enabled = false;
+
+// If the NPB_TRACE environment variable names a file, enable tracing and
+// write the trace there at exit as Chrome trace-event JSON (open it in
+// chrome://tracing or ui.perfetto.dev). process_name labels the process.
+void start_trace_from_environment(const char* process_name);
+
+// Copy of name that stays valid until the trace is written at exit
+[[nodiscard]] const char* trace_name(const std::string& name);
+
+// Append a begin or end event to the calling thread's own buffer; no locks
+// after the thread's first event. name must outlive the trace.
+void trace_begin(const char* name) noexcept;
+void trace_end(const char* name) noexcept;
+
+} // namespace npb::utils